@@ -0,0 +1,221 @@
+#include "generator.hpp"
+#include <pugixml.hpp>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace generator {
+
+    // Виды типов, которые умеет генерировать проект
+    enum class TypeKind { String, Int, Float, Ref };
+
+    // Разбирает долю типов вида "string:4,int:2,float:2,ref:2"
+    static vector<pair<TypeKind, int>> parseTypeMix(const string& mix) {
+        vector<pair<TypeKind, int>> output;
+        size_t start = 0;
+        while (start < mix.size()) {
+            size_t end = mix.find(',', start);
+            if (end == string::npos) {
+                end = mix.size();
+            }
+            string item = mix.substr(start, end - start);
+            size_t colon = item.find(':');
+            string name = item.substr(0, colon);
+            int weight = colon == string::npos ? 1 : stoi(item.substr(colon + 1));
+
+            if (name == "string") output.push_back({TypeKind::String, weight});
+            else if (name == "int") output.push_back({TypeKind::Int, weight});
+            else if (name == "float") output.push_back({TypeKind::Float, weight});
+            else if (name == "ref") output.push_back({TypeKind::Ref, weight});
+            else throw invalid_argument("Неизвестный тип в смеси: " + name);
+
+            start = end + 1;
+        }
+        if (output.empty()) {
+            throw invalid_argument("Пустая смесь типов");
+        }
+        return output;
+    }
+
+    // Состояние генерации одного проекта
+    class ProjectWriter {
+        public:
+        ProjectWriter(const Options& options, fs::path root)
+            : mOptions{options}
+            , mRoot{root}
+            , mRandom{options.seed}
+            , mTypeMix{parseTypeMix(options.typeMix)}
+        {
+            for (int i = 0; i < options.languages; i++) {
+                mLanguageCodes.push_back(i == 0 ? "ru" : "l" + to_string(i));
+            }
+            for (const auto& item : mTypeMix) {
+                mTypeWeightTotal += item.second;
+            }
+        }
+
+        int write() {
+            fs::create_directories(mRoot / "Languages");
+            fs::create_directories(mRoot / "Catalogs");
+            fs::create_directories(mRoot / "Documents");
+
+            pugi::xml_document projectDoc;
+            auto project = projectDoc.append_child("project");
+            project.append_child("id").text().set("Синтетика");
+            addSynonym(project, "Синтетическая конфигурация");
+            project.append_child("comment");
+            project.append_child("version");
+            project.append_child("vendor").text().set("spb-bench");
+            project.append_child("dev-version").text().set("1.0.0");
+            project.append_child("update-address");
+            project.append_child("default-language").text().set("Язык0");
+
+            auto languages = project.append_child("languages");
+            for (int i = 0; i < mOptions.languages; i++) {
+                string name = "Язык" + to_string(i);
+                writeLanguage(name, mLanguageCodes[i]);
+                languages.append_child("include").text().set(name + ".xml");
+            }
+
+            auto catalogs = project.append_child("catalogs");
+            for (int i = 0; i < mOptions.catalogs; i++) {
+                string name = "Справочник" + to_string(i);
+                writeObject("catalog", mRoot / "Catalogs" / (name + ".xml"), name);
+                catalogs.append_child("include").text().set(name + ".xml");
+            }
+
+            auto documents = project.append_child("documents");
+            for (int i = 0; i < mOptions.documents; i++) {
+                string name = "Документ" + to_string(i);
+                writeObject("document", mRoot / "Documents" / (name + ".xml"), name);
+                documents.append_child("include").text().set(name + ".xml");
+            }
+
+            save(projectDoc, mRoot / "project.xml");
+            return mOptions.languages + mOptions.catalogs + mOptions.documents;
+        }
+
+        private:
+        void save(const pugi::xml_document& doc, const fs::path& path) {
+            if (!doc.save_file(path.c_str())) {
+                throw runtime_error("Не удалось записать " + path.string());
+            }
+        }
+
+        void addSynonym(pugi::xml_node parent, const string& text) {
+            auto ls = parent.append_child("synonym").append_child("localised-string");
+            for (const auto& code : mLanguageCodes) {
+                auto lang = ls.append_child("language");
+                lang.append_attribute("id").set_value(code);
+                lang.text().set(code == "ru" ? text : text + " (" + code + ")");
+            }
+        }
+
+        void writeLanguage(const string& name, const string& code) {
+            pugi::xml_document doc;
+            auto root = doc.append_child("language-definition");
+            root.append_child("id").text().set(name);
+            addSynonym(root, name);
+            root.append_child("comment");
+            root.append_child("code").text().set(code);
+            save(doc, mRoot / "Languages" / (name + ".xml"));
+        }
+
+        void addType(pugi::xml_node parent) {
+            auto type = parent.append_child("type");
+            int pick = uniform_int_distribution<int>(0, mTypeWeightTotal - 1)(mRandom);
+            TypeKind kind = mTypeMix.back().first;
+            for (const auto& item : mTypeMix) {
+                if (pick < item.second) {
+                    kind = item.first;
+                    break;
+                }
+                pick -= item.second;
+            }
+
+            // Ссылаться можно только на существующие справочники
+            if (kind == TypeKind::Ref && mOptions.catalogs == 0) {
+                kind = TypeKind::String;
+            }
+
+            switch (kind) {
+                case TypeKind::String:
+                    type.append_attribute("id").set_value("std::string");
+                    type.append_attribute("length").set_value(
+                        uniform_int_distribution<int>(10, 150)(mRandom)
+                    );
+                    type.append_attribute("variable").set_value(true);
+                    break;
+                case TypeKind::Int:
+                    type.append_attribute("id").set_value("std::int");
+                    type.append_attribute("length").set_value(10);
+                    type.append_attribute("onlyPositive").set_value(false);
+                    break;
+                case TypeKind::Float:
+                    type.append_attribute("id").set_value("std::float");
+                    type.append_attribute("length").set_value(15);
+                    type.append_attribute("fractionLength").set_value(3);
+                    type.append_attribute("onlyPositive").set_value(true);
+                    break;
+                case TypeKind::Ref: {
+                    int target = uniform_int_distribution<int>(0, mOptions.catalogs - 1)(mRandom);
+                    type.append_attribute("id").set_value(
+                        "x::CatalogRef::Справочник" + to_string(target)
+                    );
+                    break;
+                }
+            }
+        }
+
+        void addAttribute(pugi::xml_node parent, const string& tag, const string& name) {
+            auto node = parent.append_child(tag);
+            node.append_child("id").text().set(name);
+            addSynonym(node, "Реквизит " + name);
+            node.append_child("comment");
+            addType(node);
+        }
+
+        void writeObject(const string& rootTag, const fs::path& path, const string& name) {
+            pugi::xml_document doc;
+            auto root = doc.append_child(rootTag);
+            root.append_child("id").text().set(name);
+            addSynonym(root, "Объект " + name);
+            root.append_child("comment").text().set("Сгенерировано автоматически");
+
+            auto properties = root.append_child("properties");
+            for (int i = 0; i < mOptions.attributes; i++) {
+                addAttribute(properties, "property", "Реквизит" + to_string(i));
+            }
+
+            auto tabulars = root.append_child("tabular-sections");
+            for (int t = 0; t < mOptions.tabularSections; t++) {
+                auto ts = tabulars.append_child("tabular-section");
+                string tsName = "Таблица" + to_string(t);
+                ts.append_child("id").text().set(tsName);
+                addSynonym(ts, "Таблица " + tsName);
+                ts.append_child("comment");
+                auto columns = ts.append_child("columns");
+                for (int c = 0; c < mOptions.columns; c++) {
+                    addAttribute(columns, "column", "Колонка" + to_string(c));
+                }
+            }
+
+            save(doc, path);
+        }
+
+        const Options& mOptions;
+        fs::path mRoot;
+        mt19937 mRandom;
+        vector<pair<TypeKind, int>> mTypeMix;
+        int mTypeWeightTotal = 0;
+        vector<string> mLanguageCodes;
+    };
+
+    int generate(const Options& options, fs::path root) {
+        if (options.languages < 1) {
+            throw invalid_argument("Нужен хотя бы один язык");
+        }
+        ProjectWriter writer(options, root);
+        return writer.write();
+    }
+}
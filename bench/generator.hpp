@@ -0,0 +1,39 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+// Генератор синтетических проектов SUPER для замеров производительности
+#include <filesystem>
+#include <string>
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+namespace generator {
+
+    // Параметры генерируемого проекта
+    struct Options {
+        // Количество справочников
+        int catalogs = 10;
+        // Количество документов
+        int documents = 10;
+        // Реквизитов у каждого справочника и документа
+        int attributes = 10;
+        // Табличных частей у каждого справочника и документа
+        int tabularSections = 1;
+        // Колонок в каждой табличной части
+        int columns = 5;
+        // Количество языков
+        int languages = 1;
+        // Доли типов реквизитов и колонок: строка, число, дробное, ссылка
+        string typeMix = "string:4,int:2,float:2,ref:2";
+        // Зерно генератора случайных чисел, от него зависит весь проект
+        unsigned seed = 1;
+    };
+
+    // Создаёт проект в каталоге root (project.xml и файлы объектов).
+    // Возвращает количество созданных объектов верхнего уровня
+    int generate(const Options& options, fs::path root);
+}
+
+#endif
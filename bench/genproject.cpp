@@ -0,0 +1,52 @@
+// Генерирует синтетический проект SUPER
+#include <iostream>
+#include <argparse/argparse.hpp>
+#include "generator.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    argparse::ArgumentParser program("spb-genproject", "0.0.1");
+
+    // Каталог, в котором создаётся проект
+    program.add_argument("-o", "--output");
+
+    program.add_argument("--catalogs").default_value(10).scan<'i', int>();
+    program.add_argument("--documents").default_value(10).scan<'i', int>();
+    program.add_argument("--attributes").default_value(10).scan<'i', int>();
+    program.add_argument("--tabular-sections").default_value(1).scan<'i', int>();
+    program.add_argument("--columns").default_value(5).scan<'i', int>();
+    program.add_argument("--languages").default_value(1).scan<'i', int>();
+    program.add_argument("--seed").default_value(1).scan<'i', int>();
+
+    // Доли типов реквизитов: "string:4,int:2,float:2,ref:2"
+    program.add_argument("--type-mix")
+        .default_value(string("string:4,int:2,float:2,ref:2"));
+
+    try {
+        program.parse_args(argc, argv);
+    }
+    catch (const exception& err) {
+        cerr << err.what() << endl;
+        cerr << program;
+        return 1;
+    }
+
+    generator::Options options;
+    options.catalogs        = program.get<int>("catalogs");
+    options.documents       = program.get<int>("documents");
+    options.attributes      = program.get<int>("attributes");
+    options.tabularSections = program.get<int>("tabular-sections");
+    options.columns         = program.get<int>("columns");
+    options.languages       = program.get<int>("languages");
+    options.seed            = program.get<int>("seed");
+    options.typeMix         = program.get<string>("type-mix");
+
+    try {
+        int objects = generator::generate(options, program.get<string>("output"));
+        cout << "Создано объектов: " << objects << endl;
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,195 @@
+// Микрозамеры функций, которые вызываются для каждого реквизита.
+// Для каждой функции измеряется время вызова и количество выделений памяти.
+// Выделения считаются учётом памяти memstats: глобальные operator new/delete
+// и функции выделения памяти pugixml
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <argparse/argparse.hpp>
+#include <pugixml.hpp>
+#include <spdlog/spdlog.h>
+#include "ids.hpp"
+#include "jsontools.hpp"
+#include "memstats.hpp"
+#include "modules.hpp"
+#include "typing.hpp"
+#include "xmltools.hpp"
+
+using namespace std;
+
+// Результат замера одной функции
+struct Result {
+    string name;
+    uint64_t iterations;
+    double nsPerCall;
+    double allocationsPerCall;
+    double bytesPerCall;
+};
+
+// Замеряет fn. Число повторов подбирается так, чтобы замер шёл не меньше
+// minSeconds. prepare вызывается перед каждой пачкой вызовов вне замера
+static Result measure(
+    const string& name,
+    double minSeconds,
+    const function<void()>& prepare,
+    const function<void()>& fn)
+{
+    const uint64_t batch = 1000;
+
+    // Прогрев: статические данные и кэши не должны попасть в замер
+    prepare();
+    for (uint64_t i = 0; i < batch; i++) {
+        fn();
+    }
+
+    uint64_t iterations = 0;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    chrono::nanoseconds elapsed{0};
+    while (chrono::duration<double>(elapsed).count() < minSeconds) {
+        prepare();
+        auto before = memstats::getHeap();
+        auto start = chrono::steady_clock::now();
+        for (uint64_t i = 0; i < batch; i++) {
+            fn();
+        }
+        elapsed += chrono::steady_clock::now() - start;
+        auto after = memstats::getHeap();
+        allocations += after.allocations - before.allocations;
+        bytes += after.allocatedBytes - before.allocatedBytes;
+        iterations += batch;
+    }
+
+    return {
+        name,
+        iterations,
+        (double)elapsed.count() / iterations,
+        (double)allocations / iterations,
+        (double)bytes / iterations
+    };
+}
+
+int main(int argc, char* argv[]) {
+    argparse::ArgumentParser program("spb-micro", "0.0.1");
+
+    // Файл для результатов в формате JSON
+    program.add_argument("--json");
+
+    // Минимальное время замера одной функции, секунды
+    program.add_argument("--min-time")
+        .default_value(0.2)
+        .scan<'g', double>();
+
+    try {
+        program.parse_args(argc, argv);
+    }
+    catch (const exception& err) {
+        cerr << err.what() << endl;
+        cerr << program;
+        return 1;
+    }
+
+    memstats::enable();
+    double minSeconds = program.get<double>("min-time");
+
+    // Исходные данные: синоним и типы в том виде, в каком они лежат в SUPER
+    pugi::xml_document source;
+    source.load_string(
+        "<property>"
+        "<synonym><localised-string>"
+        "<language id=\"ru\">Номенклатура товаров</language>"
+        "<language id=\"en\">Goods nomenclature</language>"
+        "</localised-string></synonym>"
+        "<string id=\"std::string\" length=\"150\" variable=\"true\"/>"
+        "<int id=\"std::int\" length=\"10\" onlyPositive=\"true\"/>"
+        "<float id=\"std::float\" length=\"15\" fractionLength=\"3\"/>"
+        "<ref id=\"x::CatalogRef::Номенклатура\"/>"
+        "</property>"
+    );
+    pugi::xml_node property = source.child("property");
+    auto synonym = xmltools::parseLocalisedString(property.child("synonym"));
+
+    vector<pair<string, shared_ptr<typing::Type>>> types{
+        {"String", xmltools::parseTypeNode(property.child("string"))},
+        {"Integer", xmltools::parseTypeNode(property.child("int"))},
+        {"Float", xmltools::parseTypeNode(property.child("float"))},
+        {"Ref", xmltools::parseTypeNode(property.child("ref"))},
+    };
+
+    // Документ, в который добавляются узлы. Пересоздаётся перед каждой
+    // пачкой, чтобы не расти бесконечно
+    pugi::xml_document target;
+    pugi::xml_node parent;
+    auto resetTarget = [&]() {
+        target.reset();
+        parent = target.append_child("Properties");
+    };
+    auto nothing = []() {};
+
+    // Разные seed, как у реквизитов в реальной выгрузке
+    vector<string> seeds;
+    for (int i = 0; i < 1000; i++) {
+        seeds.push_back("Catalog.Номенклатура.Attribute.Реквизит" + to_string(i));
+    }
+    size_t seedIndex = 0;
+
+    vector<Result> results;
+    results.push_back(measure("ids::getUUIDFor", minSeconds, nothing, [&]() {
+        auto uuid = ids::getUUIDFor(seeds[seedIndex++ % seeds.size()]);
+        (void)uuid;
+    }));
+    results.push_back(measure("ids::getUUID", minSeconds, nothing, []() {
+        auto uuid = ids::getUUID();
+        (void)uuid;
+    }));
+    results.push_back(measure("xmltools::parseLocalisedString", minSeconds, nothing, [&]() {
+        auto parsed = xmltools::parseLocalisedString(property.child("synonym"));
+        (void)parsed;
+    }));
+    results.push_back(measure("xmltools::addLocalisedString", minSeconds, resetTarget, [&]() {
+        xmltools::addLocalisedString(parent.append_child("Synonym"), synonym);
+    }));
+    results.push_back(measure("xmltools::parseTypeNode", minSeconds, nothing, [&]() {
+        auto type = xmltools::parseTypeNode(property.child("string"));
+        (void)type;
+    }));
+    for (const auto& type : types) {
+        results.push_back(measure(
+            "typing::" + type.first + "::addTypeNode",
+            minSeconds,
+            resetTarget,
+            [&]() { type.second->addTypeNode(parent); }
+        ));
+    }
+
+    // Модуль с BOM, как его пишут конфигуратор и EDT
+    const string module = "\xEF\xBB\xBFПроцедура Тест()\n    Сообщить(\"Тест\");\nКонецПроцедуры\n";
+    results.push_back(measure("modules::validate", minSeconds, nothing, [&]() {
+        modules::validate(module, "micro.bsl");
+    }));
+
+    for (const auto& r : results) {
+        spdlog::info(
+            "{:<40} {:>10.1f} нс {:>8.2f} выд. {:>10.1f} байт",
+            r.name, r.nsPerCall, r.allocationsPerCall, r.bytesPerCall
+        );
+    }
+
+    if (program.is_used("json")) {
+        ofstream json(program.get<string>("json"));
+        json << "{\n  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const auto& r = results[i];
+            json << "    {\"name\": " << jsontools::quote(r.name)
+                 << ", \"iterations\": " << r.iterations
+                 << ", \"ns_per_call\": " << r.nsPerCall
+                 << ", \"allocations_per_call\": " << r.allocationsPerCall
+                 << ", \"bytes_per_call\": " << r.bytesPerCall
+                 << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        json << "  ]\n}\n";
+    }
+}
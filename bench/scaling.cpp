@@ -0,0 +1,187 @@
+// Замер масштабируемости spb на синтетических проектах разного размера.
+// Для каждого размера генерирует проект, запускает spb и выводит
+// объекты в секунду, записанные байты в секунду и пиковую память процесса
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <argparse/argparse.hpp>
+#include "generator.hpp"
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+// Результат одного прогона
+struct Sample {
+    int objects;
+    double seconds;
+    uintmax_t bytesWritten;
+    long peakRssKb;
+};
+
+// Суммарный размер файлов в каталоге
+static uintmax_t directorySize(const fs::path& root) {
+    uintmax_t total = 0;
+    for (const auto& entry : fs::recursive_directory_iterator(root)) {
+        if (entry.is_regular_file()) {
+            total += entry.file_size();
+        }
+    }
+    return total;
+}
+
+// Запускает spb и ждёт завершения. Возвращает пиковую память процесса
+static long runSpb(const string& spb, const vector<string>& args) {
+    vector<char*> argv;
+    argv.push_back(const_cast<char*>(spb.c_str()));
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw runtime_error("Не удалось запустить spb");
+    }
+    if (pid == 0) {
+        // Вывод spb не нужен, он искажает замер
+        if (freopen("/dev/null", "w", stdout) == nullptr) {
+            _exit(127);
+        }
+        execv(spb.c_str(), argv.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage{};
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        throw runtime_error("Не удалось дождаться spb");
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw runtime_error("spb завершился с ошибкой");
+    }
+    return usage.ru_maxrss;
+}
+
+int main(int argc, char* argv[]) {
+    argparse::ArgumentParser program("spb-scaling", "0.0.1");
+
+    // Путь к исполняемому файлу spb
+    program.add_argument("spb");
+
+    // Размеры проектов (справочники + документы)
+    program.add_argument("--sizes")
+        .default_value(string("10,100,1000,10000,50000"));
+
+    // Рабочий каталог для проектов и выгрузок
+    program.add_argument("--workdir")
+        .default_value((fs::temp_directory_path() / "spb-scaling").string());
+
+    // Файл для результатов в формате CSV
+    program.add_argument("--csv");
+
+    program.add_argument("--attributes").default_value(10).scan<'i', int>();
+    program.add_argument("--tabular-sections").default_value(1).scan<'i', int>();
+    program.add_argument("--columns").default_value(5).scan<'i', int>();
+    program.add_argument("--languages").default_value(2).scan<'i', int>();
+
+    // Дополнительные аргументы для spb, например "--streaming"
+    program.add_argument("--spb-args")
+        .default_value(string(""));
+
+    try {
+        program.parse_args(argc, argv);
+    }
+    catch (const exception& err) {
+        cerr << err.what() << endl;
+        cerr << program;
+        return 1;
+    }
+
+    fs::path workdir = program.get<string>("workdir");
+    string spb = fs::absolute(program.get<string>("spb")).string();
+
+    // Дополнительные аргументы разделены пробелами
+    vector<string> extraArgs;
+    {
+        istringstream extra(program.get<string>("spb-args"));
+        for (string arg; extra >> arg;) {
+            extraArgs.push_back(arg);
+        }
+    }
+
+    vector<int> sizes;
+    {
+        istringstream list(program.get<string>("sizes"));
+        for (string item; getline(list, item, ',');) {
+            sizes.push_back(stoi(item));
+        }
+    }
+
+    vector<Sample> samples;
+    try {
+        for (int size : sizes) {
+            fs::path projectDir = workdir / ("project-" + to_string(size));
+            fs::path outputDir = workdir / ("output-" + to_string(size));
+            fs::remove_all(projectDir);
+            fs::remove_all(outputDir);
+            fs::create_directories(outputDir);
+
+            generator::Options options;
+            options.catalogs        = size / 2;
+            options.documents       = size - size / 2;
+            options.attributes      = program.get<int>("attributes");
+            options.tabularSections = program.get<int>("tabular-sections");
+            options.columns         = program.get<int>("columns");
+            options.languages       = program.get<int>("languages");
+            options.seed            = size;
+            int objects = generator::generate(options, projectDir);
+
+            vector<string> args{"-p", projectDir.string(), "-o", outputDir.string()};
+            args.insert(args.end(), extraArgs.begin(), extraArgs.end());
+
+            auto start = chrono::steady_clock::now();
+            long peakRss = runSpb(spb, args);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            samples.push_back({objects, seconds, directorySize(outputDir), peakRss});
+            fs::remove_all(projectDir);
+            fs::remove_all(outputDir);
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    cout << setw(10) << "objects"
+         << setw(12) << "seconds"
+         << setw(14) << "objects/s"
+         << setw(14) << "MB/s"
+         << setw(16) << "peak RSS, MB" << endl;
+    for (const auto& s : samples) {
+        cout << fixed << setprecision(3)
+             << setw(10) << s.objects
+             << setw(12) << s.seconds
+             << setw(14) << setprecision(1) << s.objects / s.seconds
+             << setw(14) << s.bytesWritten / s.seconds / (1024 * 1024)
+             << setw(16) << s.peakRssKb / 1024.0 << endl;
+    }
+
+    if (program.is_used("csv")) {
+        ofstream csv(program.get<string>("csv"));
+        csv << "objects,seconds,bytes_written,objects_per_second,bytes_per_second,peak_rss_kb\n";
+        for (const auto& s : samples) {
+            csv << s.objects << ',' << s.seconds << ',' << s.bytesWritten << ','
+                << s.objects / s.seconds << ',' << s.bytesWritten / s.seconds << ','
+                << s.peakRssKb << '\n';
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#include "buildcache.hpp"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <unistd.h>
+
+namespace buildcache {
+
+    // Первая строка файла кэша. При смене формата меняется и она
+    static const char* header = "spb-cache 1";
+
+    bool getStamp(const fs::path& path, Stamp& out) {
+        error_code ec;
+        uintmax_t size = fs::file_size(path, ec);
+        if (ec) {
+            return false;
+        }
+        auto time = fs::last_write_time(path, ec);
+        if (ec) {
+            return false;
+        }
+        out.size = size;
+        out.mtime = chrono::duration_cast<chrono::nanoseconds>(time.time_since_epoch()).count();
+        return true;
+    }
+
+    uint64_t hashContent(const char* data, size_t size) {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    Cache::Cache(fs::path file) : mFile(move(file)) {
+        ifstream input(mFile);
+        string line;
+        if (!getline(input, line) || line != header) {
+            return;
+        }
+        while (getline(input, line)) {
+            size_t tab = line.find('\t');
+            if (tab == string::npos) {
+                continue;
+            }
+            Record record;
+            istringstream fields(line.substr(tab + 1));
+            fields >> record.source.size >> record.source.mtime
+                >> hex >> record.hash >> dec
+                >> record.target.size >> record.target.mtime;
+            if (fields) {
+                mRecords[line.substr(0, tab)] = record;
+            }
+        }
+    }
+
+    bool Cache::find(const string& key, Record& out) const {
+        lock_guard<mutex> lock(mMutex);
+        auto it = mRecords.find(key);
+        if (it == mRecords.end()) {
+            return false;
+        }
+        out = it->second;
+        return true;
+    }
+
+    void Cache::put(const string& key, const Record& record) {
+        // Ключ занимает первое поле строки
+        if (key.find_first_of("\t\n") != string::npos) {
+            return;
+        }
+        lock_guard<mutex> lock(mMutex);
+        mRecords[key] = record;
+    }
+
+    void Cache::save() const {
+        lock_guard<mutex> lock(mMutex);
+        ostringstream text;
+        text << header << '\n';
+        for (const auto& it : mRecords) {
+            const Record& r = it.second;
+            text << it.first << '\t'
+                << r.source.size << '\t' << r.source.mtime << '\t'
+                << hex << r.hash << dec << '\t'
+                << r.target.size << '\t' << r.target.mtime << '\n';
+        }
+
+        writeAtomically(text.str(), mFile);
+    }
+
+    void writeAtomically(const string& text, const fs::path& path) {
+        if (path.has_parent_path()) {
+            fs::create_directories(path.parent_path());
+        }
+        // Один файл могут писать несколько сборок процесса одновременно
+        // (пакетная сборка с общим кэшем пакетов): временный файл у каждой свой
+        static atomic<unsigned> sequence{0};
+        fs::path temporary = path;
+        temporary += ".tmp" + to_string(getpid()) + "-" + to_string(sequence++);
+        {
+            ofstream output(temporary, ios::binary | ios::trunc);
+            output.write(text.data(), text.size());
+            if (!output) {
+                throw runtime_error("Не удалось записать кэш сборки: " + temporary.string());
+            }
+        }
+        fs::rename(temporary, path);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef BUILDCACHE_H
+#define BUILDCACHE_H
+
+// Кэш промежуточных результатов сборки между запусками. Для каждого
+// результата хранятся отпечатки исходного и выходного файлов и хэш
+// содержимого исходного: если отпечатки совпали, файл не перечитывается
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+using namespace std;
+
+namespace buildcache {
+
+    // Отпечаток файла: размер и время изменения
+    struct Stamp {
+        uintmax_t size = 0;
+        int64_t mtime = 0;
+
+        bool operator==(const Stamp& other) const {
+            return size == other.size && mtime == other.mtime;
+        }
+    };
+
+    // Отпечаток существующего файла. Возвращает false, если файла нет
+    bool getStamp(const fs::path& path, Stamp& out);
+
+    // Хэш содержимого (FNV-1a, 64 бита)
+    uint64_t hashContent(const char* data, size_t size);
+
+    // Записывает файл кэша через временный файл и переименование: прерванная
+    // сборка не оставляет наполовину записанный кэш
+    void writeAtomically(const string& text, const fs::path& path);
+
+    // Запись кэша об одном результате
+    struct Record {
+        // Исходный файл на момент сборки
+        Stamp source;
+        // Хэш содержимого исходного файла
+        uint64_t hash = 0;
+        // Выходной файл сразу после записи
+        Stamp target;
+    };
+
+    // Файл кэша одного этапа сборки. Записи ищутся по ключу, обычно по пути
+    // выходного файла. find и put потокобезопасны
+    class Cache {
+        public:
+        // Загружает кэш из файла. Отсутствующий файл или файл другой версии
+        // дают пустой кэш
+        explicit Cache(fs::path file);
+
+        bool find(const string& key, Record& out) const;
+        void put(const string& key, const Record& record);
+
+        // Атомарно перезаписывает файл кэша
+        void save() const;
+
+        private:
+        fs::path mFile;
+        unordered_map<string, Record> mRecords;
+        mutable mutex mMutex;
+    };
+}
+
+#endif
@@ -0,0 +1,301 @@
+#include "forms.hpp"
+#include "modules.hpp"
+#include "xmltools.hpp"
+#include "ids.hpp"
+#include "parallel.hpp"
+#include "targets.hpp"
+#include "trace.hpp"
+#include "logging.hpp"
+#include "translations.hpp"
+#include <atomic>
+#include <stdexcept>
+#include <pugixml.hpp>
+#include <spdlog/spdlog.h>
+
+namespace forms {
+
+    // Имя основной формы объекта
+    static string getDefaultFormName(const string& kind) {
+        if (kind == "Catalog") {
+            return "ФормаЭлемента";
+        }
+        if (kind == "Document") {
+            return "ФормаДокумента";
+        }
+        throw logic_error("У объекта " + kind + " нет форм");
+    }
+
+    vector<Form> discover(const fs::path& objectConfigPath, const string& kind) {
+        vector<Form> output;
+        fs::path directory = objectConfigPath.parent_path();
+        string stem = objectConfigPath.stem().string();
+        fs::path source = directory / (stem + ".sml");
+        if (!fs::is_regular_file(source)) {
+            return output;
+        }
+        fs::path module = directory / (stem + ".sml.super");
+        if (!fs::is_regular_file(module)) {
+            module.clear();
+        }
+        output.push_back({getDefaultFormName(kind), source, module});
+        return output;
+    }
+
+    fs::path getFormDirectory(const fs::path& exportRoot, const Job& job) {
+        return exportRoot
+            / modules::getTypeDirectory(job.kind)
+            / job.objectName
+            / "Forms"
+            / job.form.name;
+    }
+
+    // Пространства имён файла Form.xml
+    static void addFormNamespaces(pugi::xml_node node) {
+        node.append_attribute("xmlns").set_value("http://v8.1c.ru/8.3/xcf/logform");
+        node.append_attribute("xmlns:app").set_value("http://v8.1c.ru/8.2/managed-application/core");
+        node.append_attribute("xmlns:cfg").set_value("http://v8.1c.ru/8.1/data/enterprise/current-config");
+        node.append_attribute("xmlns:v8").set_value("http://v8.1c.ru/8.1/data/core");
+        node.append_attribute("xmlns:v8ui").set_value("http://v8.1c.ru/8.1/data/ui");
+        node.append_attribute("xmlns:xr").set_value("http://v8.1c.ru/8.3/xcf/readable");
+        node.append_attribute("xmlns:xs").set_value("http://www.w3.org/2001/XMLSchema");
+        node.append_attribute("xmlns:xsi").set_value("http://www.w3.org/2001/XMLSchema-instance");
+        node.append_attribute("version").set_value(targets::getVersion().c_str());
+    }
+
+    // Заголовок элемента или формы из <title>
+    static void addTitle(pugi::xml_node parent, pugi::xml_node title) {
+        if (!title) {
+            return;
+        }
+        pugi::xml_node titleNode = parent.append_child("Title");
+        titleNode.append_attribute("formatted").set_value("false");
+        xmltools::addLocalisedString(titleNode, xmltools::parseLocalisedString(title));
+    }
+
+    // Элемент формы с именем и номером
+    static pugi::xml_node addItem(pugi::xml_node childItems, const char* type, pugi::xml_node source, int& nextId) {
+        const char* name = source.attribute("id").as_string();
+        if (*name == 0) {
+            throw runtime_error(string("У элемента <") + source.name() + "> нет id");
+        }
+        pugi::xml_node item = childItems.append_child(type);
+        item.append_attribute("name").set_value(name);
+        item.append_attribute("id").set_value(nextId++);
+        return item;
+    }
+
+    // Путь к данным элемента из атрибута data
+    static void addDataPath(pugi::xml_node item, pugi::xml_node source) {
+        const char* data = source.attribute("data").as_string();
+        if (*data) {
+            xmltools::addSubNode(item, "DataPath", data);
+        }
+    }
+
+    // Переводит элементы описания формы в ChildItems
+    static void addItems(pugi::xml_node parent, pugi::xml_node items, int& nextId) {
+        pugi::xml_node childItems;
+        for (pugi::xml_node source = items.first_child(); source; source = source.next_sibling()) {
+            string tag = source.name();
+            // Заголовок относится к владельцу, а не к его элементам
+            if (source.type() != pugi::node_element || tag == "title") {
+                continue;
+            }
+            if (!childItems) {
+                childItems = parent.append_child("ChildItems");
+            }
+            if (tag == "field") {
+                pugi::xml_node item = addItem(childItems, "InputField", source, nextId);
+                addTitle(item, source.child("title"));
+                addDataPath(item, source);
+            } else if (tag == "label") {
+                pugi::xml_node item = addItem(childItems, "LabelDecoration", source, nextId);
+                addTitle(item, source.child("title"));
+            } else if (tag == "button") {
+                pugi::xml_node item = addItem(childItems, "Button", source, nextId);
+                addTitle(item, source.child("title"));
+                xmltools::addSubNode(item, "CommandName", source.attribute("command").as_string());
+            } else if (tag == "group") {
+                pugi::xml_node item = addItem(childItems, "UsualGroup", source, nextId);
+                addTitle(item, source.child("title"));
+                string layout = source.attribute("layout").as_string("vertical");
+                if (layout == "vertical") {
+                    xmltools::addSubNode(item, "Group", "Vertical");
+                } else if (layout == "horizontal") {
+                    xmltools::addSubNode(item, "Group", "Horizontal");
+                } else {
+                    throw runtime_error("Неизвестное расположение группы: " + layout);
+                }
+                addItems(item, source, nextId);
+            } else if (tag == "table") {
+                pugi::xml_node item = addItem(childItems, "Table", source, nextId);
+                addTitle(item, source.child("title"));
+                addDataPath(item, source);
+                addItems(item, source, nextId);
+            } else {
+                throw runtime_error("Неизвестный элемент формы <" + tag + ">");
+            }
+        }
+    }
+
+    void compile(const string& sml, const Job& job, string& formXml, string& metadataXml) {
+        pugi::xml_document source;
+        pugi::xml_parse_result parsed = source.load_buffer(sml.data(), sml.size());
+        if (!parsed) {
+            throw runtime_error(
+                string("Ошибка разбора: ") + parsed.description()
+                + " (смещение " + to_string(parsed.offset) + ")"
+            );
+        }
+        pugi::xml_node form = source.child("form");
+        if (!form) {
+            throw runtime_error("Нет корневого элемента <form>");
+        }
+
+        // Ext/Form.xml
+        {
+            pugi::xml_document doc;
+            pugi::xml_node root = doc.append_child("Form");
+            addFormNamespaces(root);
+            addTitle(root, form.child("title"));
+            pugi::xml_node commandBar = root.append_child("AutoCommandBar");
+            commandBar.append_attribute("name").set_value("ФормаКоманднаяПанель");
+            commandBar.append_attribute("id").set_value(-1);
+
+            int nextId = 1;
+            pugi::xml_node items = form.child("items");
+            if (items) {
+                addItems(root, items, nextId);
+            }
+
+            // Основной реквизит - сам объект
+            pugi::xml_node attribute = root.append_child("Attributes").append_child("Attribute");
+            attribute.append_attribute("name").set_value("Объект");
+            attribute.append_attribute("id").set_value(1);
+            xmltools::addSubNode(
+                attribute.append_child("Type"),
+                "v8:Type",
+                "cfg:" + job.kind + "Object." + job.objectName
+            );
+            xmltools::addSubNode(attribute, "MainAttribute", "true");
+            xmltools::addSubNode(attribute, "SavedData", "true");
+
+            xmltools::serializeDocument(doc, formXml);
+        }
+
+        // Объект формы
+        {
+            string qualifiedName = job.kind + "." + job.objectName + ".Form." + job.form.name;
+            pugi::xml_document doc;
+            pugi::xml_node md = doc.append_child("MetaDataObject");
+            xmltools::addNamespaces(md);
+            pugi::xml_node obj = md.append_child("Form");
+            obj.append_attribute("uuid").set_value(ids::getUUIDFor(qualifiedName).c_str());
+            pugi::xml_node properties = obj.append_child("Properties");
+            xmltools::addNameNode(properties, job.form.name);
+            xmltools::addSynonymNode(properties, form.child("synonym"));
+            xmltools::addCommentNode(properties, form.child("comment").text().get());
+            xmltools::addSubNode(properties, "FormType", "Managed");
+            xmltools::addSubNode(properties, "IncludeHelpInContents", "false");
+            pugi::xml_node purpose = properties.append_child("UsePurposes").append_child("v8:Value");
+            purpose.append_attribute("xsi:type").set_value("app:ApplicationUsePurpose");
+            purpose.text().set("PlatformApplication");
+
+            xmltools::serializeDocument(doc, metadataXml);
+        }
+    }
+
+    // Компилирует одну форму. Возвращает false, если форма не изменилась.
+    // force - пересобрать, даже если описание формы не менялось
+    static bool buildForm(const Job& job, const fs::path& exportRoot, buildcache::Cache* cache, bool force) {
+        trace::Span span("forms", "compileForm", job.form.source.string());
+        fs::path directory = getFormDirectory(exportRoot, job);
+        fs::path target = directory / "Ext" / "Form.xml";
+        fs::path metadata = directory.parent_path() / (job.form.name + ".xml");
+        string key = fs::absolute(target).lexically_normal().string();
+
+        buildcache::Stamp sourceStamp;
+        if (!buildcache::getStamp(job.form.source, sourceStamp)) {
+            throw runtime_error("Не удалось прочитать форму: " + job.form.source.string());
+        }
+        buildcache::Record cached;
+        bool known = cache != nullptr && cache->find(key, cached);
+        buildcache::Stamp targetStamp;
+        bool targetIntact = known
+            && buildcache::getStamp(target, targetStamp)
+            && cached.target == targetStamp
+            && fs::is_regular_file(metadata);
+
+        // Ни описание формы, ни выгруженный файл не трогали
+        if (!force && targetIntact && cached.source == sourceStamp) {
+            return false;
+        }
+
+        string sml = xmltools::readFile(job.form.source);
+        uint64_t hash = buildcache::hashContent(sml.data(), sml.size());
+
+        // Файл описания тронули, но содержимое то же
+        bool changed = force || !(targetIntact && cached.hash == hash);
+        if (changed) {
+            string formXml;
+            string metadataXml;
+            try {
+                compile(sml, job, formXml, metadataXml);
+            } catch (const runtime_error& e) {
+                throw runtime_error(job.form.source.string() + ": " + e.what());
+            }
+            fs::create_directories(target.parent_path());
+            xmltools::writeFile(formXml, target);
+            xmltools::writeFile(metadataXml, metadata);
+            buildcache::getStamp(target, targetStamp);
+            spdlog::debug("Форма: {}", target.string());
+        }
+
+        if (cache != nullptr) {
+            cache->put(key, {sourceStamp, hash, targetStamp});
+        }
+        return changed;
+    }
+
+    Result build(const vector<Job>& jobs, const fs::path& exportRoot, buildcache::Cache* cache) {
+        logging::Progress progress("Формы", jobs.size());
+
+        // Заголовки форм переводятся по таблице переводов и отбираются по
+        // языкам выгрузки, файлы пишутся в версии формата: если что-то из
+        // этого изменилось с прошлой сборки, пересобираются все формы
+        const translations::Table* strings = translations::getActive();
+        uint64_t fingerprint = strings == nullptr ? 0 : strings->getFingerprint();
+        const string& format = targets::getVersion();
+        uint64_t formatHash = buildcache::hashContent(format.data(), format.size());
+        string languages;
+        for (const auto& code : xmltools::getLanguageFilter()) {
+            languages += code;
+            languages += ',';
+        }
+        uint64_t languagesHash = buildcache::hashContent(languages.data(), languages.size());
+        buildcache::Record environment;
+        bool force = cache != nullptr
+            && (!cache->find("translations", environment) || environment.hash != fingerprint
+                || !cache->find("format", environment) || environment.hash != formatHash
+                || !cache->find("languages", environment) || environment.hash != languagesHash);
+
+        atomic<size_t> built{0};
+        parallel::forEach(jobs.size(), [&](size_t i) {
+            translations::Scope scope(strings);
+            if (buildForm(jobs[i], exportRoot, cache, force)) {
+                built++;
+            }
+            progress.step();
+        });
+        if (cache != nullptr) {
+            cache->put("translations", {{}, fingerprint, {}});
+            cache->put("format", {{}, formatHash, {}});
+            cache->put("languages", {{}, languagesHash, {}});
+        }
+
+        Result result;
+        result.built = built;
+        result.unchanged = jobs.size() - result.built;
+        return result;
+    }
+}
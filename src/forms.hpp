@@ -0,0 +1,62 @@
+#ifndef FORMS_H
+#define FORMS_H
+
+// Управляемые формы. Форма описывается файлом <Имя>.sml рядом с файлом
+// настроек объекта, модуль формы - файлом <Имя>.sml.super. Форма
+// компилируется в Forms/<Форма>.xml и Forms/<Форма>/Ext/Form.xml
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "buildcache.hpp"
+
+namespace fs = std::filesystem;
+using namespace std;
+
+namespace forms {
+
+    // Форма, найденная в проекте
+    struct Form {
+        // Имя формы в конфигурации
+        string name;
+        // Файл .sml
+        fs::path source;
+        // Файл модуля формы, пустой - модуля нет
+        fs::path module;
+    };
+
+    // Формы объекта kind ("Catalog", "Document") рядом с файлом настроек
+    // objectConfigPath. <Имя>.sml - основная форма объекта: ФормаЭлемента
+    // у справочника, ФормаДокумента у документа
+    vector<Form> discover(const fs::path& objectConfigPath, const string& kind);
+
+    // Задание на компиляцию формы
+    struct Job {
+        // Вид и имя объекта-владельца
+        string kind;
+        string objectName;
+        Form form;
+    };
+
+    // Каталог формы в выгрузке: <Catalogs|Documents>/<Объект>/Forms/<Форма>
+    fs::path getFormDirectory(const fs::path& exportRoot, const Job& job);
+
+    // Компилирует описание формы sml. В formXml выводится Ext/Form.xml,
+    // в metadataXml - файл объекта формы. При ошибке бросает runtime_error
+    void compile(const string& sml, const Job& job, string& formXml, string& metadataXml);
+
+    // Итог этапа форм
+    struct Result {
+        // Скомпилировано заново
+        size_t built = 0;
+        // Не изменились с прошлой сборки
+        size_t unchanged = 0;
+    };
+
+    // Компилирует формы на рабочих потоках. cache может быть nullptr:
+    // тогда все формы компилируются заново. Заголовки переводятся по
+    // таблице, действующей в вызывающем потоке
+    Result build(const vector<Job>& jobs, const fs::path& exportRoot, buildcache::Cache* cache);
+}
+
+#endif
@@ -0,0 +1,62 @@
+#include "graph.hpp"
+#include <stdexcept>
+
+namespace graph {
+
+    Closure parseClosure(const string& value) {
+        if (value == "none") {
+            return Closure::None;
+        }
+        if (value == "forward") {
+            return Closure::Forward;
+        }
+        if (value == "reverse") {
+            return Closure::Reverse;
+        }
+        throw invalid_argument("Неизвестное направление замыкания: " + value);
+    }
+
+    void DependencyGraph::addNode(const string& key) {
+        mForward[key];
+        mReverse[key];
+    }
+
+    void DependencyGraph::addEdge(const string& from, const string& to) {
+        addNode(from);
+        addNode(to);
+        mForward[from].insert(to);
+        mReverse[to].insert(from);
+    }
+
+    bool DependencyGraph::contains(const string& key) const {
+        return mForward.count(key) != 0;
+    }
+
+    unordered_set<string> DependencyGraph::closure(
+        const vector<string>& roots,
+        Closure direction
+    ) const {
+        unordered_set<string> visited(roots.begin(), roots.end());
+        if (direction == Closure::None) {
+            return visited;
+        }
+
+        const auto& edges = direction == Closure::Forward ? mForward : mReverse;
+        vector<string> stack(roots.begin(), roots.end());
+        while (!stack.empty()) {
+            string key = stack.back();
+            stack.pop_back();
+
+            auto it = edges.find(key);
+            if (it == edges.end()) {
+                continue;
+            }
+            for (const auto& next : it->second) {
+                if (visited.insert(next).second) {
+                    stack.push_back(next);
+                }
+            }
+        }
+        return visited;
+    }
+}
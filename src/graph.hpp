@@ -0,0 +1,52 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+// Граф зависимостей между объектами конфигурации
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+namespace graph {
+
+    // Направление замыкания зависимостей
+    enum class Closure {
+        // Только указанные объекты
+        None,
+        // Указанные объекты и всё, на что они ссылаются
+        Forward,
+        // Указанные объекты и всё, что ссылается на них
+        Reverse
+    };
+
+    // Разбирает направление замыкания из строки (none, forward, reverse).
+    // Выбрасывает invalid_argument для неизвестных значений
+    Closure parseClosure(const string& value);
+
+    // Ориентированный граф: ребро A -> B означает, что A ссылается на B.
+    // Узлы - полные имена объектов вида "Catalog.Номенклатура"
+    class DependencyGraph {
+        public:
+        // Добавляет узел
+        void addNode(const string& key);
+        // Добавляет ребро from -> to. Узлы добавляются при необходимости
+        void addEdge(const string& from, const string& to);
+        // Есть ли узел
+        bool contains(const string& key) const;
+        // Возвращает roots вместе с замыканием в указанном направлении
+        unordered_set<string> closure(
+            const vector<string>& roots,
+            Closure direction
+        ) const;
+
+        private:
+        // Исходящие рёбра
+        unordered_map<string, unordered_set<string>> mForward;
+        // Входящие рёбра
+        unordered_map<string, unordered_set<string>> mReverse;
+    };
+}
+
+#endif
@@ -8,25 +8,28 @@
 
 namespace ids {
     string getConfigurationVersionString() {
-        static std::string charset = "abcdefghijklmnopqrstuvwxyz1234567890";
+        static const std::string charset = "abcdefghijklmnopqrstuvwxyz1234567890";
+        // Генераторы отдельные для каждого потока: версии создаются параллельно
+        thread_local mt19937 gen{random_device{}()};
+        std::uniform_int_distribution<size_t> dis(0, charset.length() - 1);
         std::string result;
         result.resize(40);
         for (int i = 0; i < 40; i++) {
-            result[i] = charset[rand() % charset.length()];
+            result[i] = charset[dis(gen)];
         }
         return result;
     }
 
     string getUUID() {
-        static UUIDv4::UUIDGenerator<std::mt19937_64> uuidGenerator;
+        thread_local UUIDv4::UUIDGenerator<std::mt19937_64> uuidGenerator;
         UUIDv4::UUID uuid = uuidGenerator.getUUID();
         return uuid.str();
     }
 
     string getUUIDFor(string seed) {
         static hash<string> hash_func;
-        static mt19937_64 gen;
-        static std::uniform_int_distribution<uint64_t> dis(0, UINT64_MAX);
+        thread_local mt19937_64 gen;
+        std::uniform_int_distribution<uint64_t> dis(0, UINT64_MAX);
 
         gen.seed(hash_func(seed));
 
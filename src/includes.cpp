@@ -0,0 +1,188 @@
+#include "includes.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <fnmatch.h>
+#include <map>
+#include <stdexcept>
+#include <unordered_set>
+#include <spdlog/spdlog.h>
+
+namespace includes {
+
+    // Запись каталога
+    struct Entry {
+        string name;
+        bool directory;
+    };
+
+    static bool hasWildcards(const string& text) {
+        return text.find_first_of("*?[") != string::npos;
+    }
+
+    // Читает каталоги directories параллельно, каждый одним проходом.
+    // Отсутствующий каталог даёт пустой список
+    static map<fs::path, vector<Entry>> readDirectories(const vector<fs::path>& directories) {
+        vector<vector<Entry>> listings(directories.size());
+        parallel::forEach(directories.size(), [&](size_t i) {
+            trace::Span span("includes", "readDirectory", directories[i].string());
+            error_code error;
+            fs::directory_iterator it(directories[i], error);
+            if (error) {
+                return;
+            }
+            // Вид записи берётся из readdir, stat нужен только ссылкам
+            for (const auto& entry : it) {
+                listings[i].push_back({
+                    entry.path().filename().string(),
+                    entry.is_directory(error)
+                });
+            }
+        });
+        map<fs::path, vector<Entry>> output;
+        for (size_t i = 0; i < directories.size(); i++) {
+            output[directories[i]] = move(listings[i]);
+        }
+        return output;
+    }
+
+    vector<fs::path> resolve(
+        const vector<string>& patterns,
+        const fs::path& base,
+        const string& extension)
+    {
+        // Шаблон в процессе разбора: каталог, до которого части пути уже
+        // сопоставлены, и оставшиеся части
+        struct Pending {
+            size_t item;
+            fs::path directory;
+            vector<string> rest;
+        };
+        // Найденное по каждому элементу
+        vector<vector<fs::path>> found(patterns.size());
+        // Элементы, раскрытые по шаблону или каталогу: их пути упорядочиваются
+        vector<bool> expanded(patterns.size(), false);
+        vector<Pending> pending;
+        // Каталоги, из которых берутся все файлы нужного вида
+        vector<pair<size_t, fs::path>> listed;
+
+        auto addDirectory = [&](size_t item, const fs::path& directory) {
+            expanded[item] = true;
+            listed.push_back({item, directory});
+        };
+
+        // Каталог из элемента без шаблона: проверяется, только если путь не
+        // похож на файл нужного вида
+        vector<size_t> candidates;
+        for (size_t i = 0; i < patterns.size(); i++) {
+            fs::path relative(patterns[i]);
+            if (!hasWildcards(patterns[i])) {
+                found[i].push_back(base / relative);
+                if (!extension.empty() && relative.extension() != extension) {
+                    candidates.push_back(i);
+                }
+                continue;
+            }
+            expanded[i] = true;
+            Pending item{i, base, {}};
+            bool wildcard = false;
+            for (const auto& part : relative) {
+                if (!wildcard && !hasWildcards(part.string())) {
+                    item.directory /= part;
+                } else {
+                    wildcard = true;
+                    item.rest.push_back(part.string());
+                }
+            }
+            pending.push_back(move(item));
+        }
+        if (!candidates.empty()) {
+            vector<char> isDirectory(candidates.size(), 0);
+            parallel::forEach(candidates.size(), [&](size_t i) {
+                error_code error;
+                isDirectory[i] = fs::is_directory(found[candidates[i]].front(), error);
+            });
+            for (size_t i = 0; i < candidates.size(); i++) {
+                if (isDirectory[i]) {
+                    fs::path directory = found[candidates[i]].front();
+                    found[candidates[i]].clear();
+                    addDirectory(candidates[i], directory);
+                }
+            }
+        }
+
+        // Шаблоны сопоставляются по уровням: все каталоги уровня читаются
+        // вместе
+        while (!pending.empty()) {
+            vector<fs::path> directories;
+            for (const auto& item : pending) {
+                directories.push_back(item.directory);
+            }
+            sort(directories.begin(), directories.end());
+            directories.erase(unique(directories.begin(), directories.end()), directories.end());
+            auto listings = readDirectories(directories);
+
+            vector<Pending> next;
+            for (const auto& item : pending) {
+                const string& part = item.rest.front();
+                bool last = item.rest.size() == 1;
+                for (const auto& entry : listings[item.directory]) {
+                    if (fnmatch(part.c_str(), entry.name.c_str(), FNM_PERIOD) != 0) {
+                        continue;
+                    }
+                    fs::path path = item.directory / entry.name;
+                    if (!last) {
+                        if (entry.directory) {
+                            next.push_back({item.item, path, {item.rest.begin() + 1, item.rest.end()}});
+                        }
+                    } else if (extension.empty()) {
+                        if (entry.directory) {
+                            found[item.item].push_back(path);
+                        }
+                    } else if (entry.directory) {
+                        addDirectory(item.item, path);
+                    } else if (path.extension() == extension) {
+                        found[item.item].push_back(path);
+                    }
+                }
+            }
+            pending = move(next);
+        }
+
+        // Каталоги целиком: файлы нужного вида без подкаталогов
+        if (!listed.empty()) {
+            vector<fs::path> directories;
+            for (const auto& item : listed) {
+                directories.push_back(item.second);
+            }
+            auto listings = readDirectories(directories);
+            for (const auto& item : listed) {
+                for (const auto& entry : listings[item.second]) {
+                    fs::path path = item.second / entry.name;
+                    if (!entry.directory && entry.name[0] != '.' && path.extension() == extension) {
+                        found[item.first].push_back(path);
+                    }
+                }
+            }
+        }
+
+        // Порядок элементов сохраняется, найденное внутри элемента
+        // упорядочено по имени: результат не зависит от порядка readdir
+        vector<fs::path> output;
+        unordered_set<string> seen;
+        for (size_t i = 0; i < patterns.size(); i++) {
+            if (expanded[i]) {
+                sort(found[i].begin(), found[i].end());
+                if (found[i].empty()) {
+                    spdlog::warn("Ничего не найдено по <include>: {}", (base / patterns[i]).string());
+                }
+            }
+            for (auto& path : found[i]) {
+                if (seen.insert(path.lexically_normal().string()).second) {
+                    output.push_back(move(path));
+                }
+            }
+        }
+        return output;
+    }
+}
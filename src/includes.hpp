@@ -0,0 +1,30 @@
+#ifndef INCLUDES_H
+#define INCLUDES_H
+
+// Разрешение элементов <include> проекта. Элемент - путь к файлу, шаблон
+// (*, ? и [...] в любых частях пути: Catalogs/Склад*.xml, */*.xml) или
+// каталог, который означает все его файлы нужного вида без подкаталогов.
+// Каталоги читаются параллельно, каждый одним проходом readdir
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace std;
+
+namespace includes {
+
+    // Возвращает пути по элементам patterns относительно каталога base в
+    // порядке элементов. Найденные по шаблону или в каталоге пути
+    // упорядочены по имени, повторы пропускаются. extension - расширение
+    // файлов (".xml"), пустое - элементы означают каталоги, а не файлы.
+    // Пути без шаблонов не проверяются: отсутствующий файл обнаружится
+    // при чтении
+    vector<fs::path> resolve(
+        const vector<string>& patterns,
+        const fs::path& base,
+        const string& extension
+    );
+}
+
+#endif
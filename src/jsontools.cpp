@@ -0,0 +1,24 @@
+#include "jsontools.hpp"
+
+namespace jsontools {
+
+    string quote(const string& value) {
+        static const char* hex = "0123456789abcdef";
+        string output = "\"";
+        for (char c : value) {
+            unsigned char ch = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') {
+                output += '\\';
+                output += c;
+            } else if (ch < 0x20) {
+                output += "\\u00";
+                output += hex[ch >> 4];
+                output += hex[ch & 0xf];
+            } else {
+                output += c;
+            }
+        }
+        output += '"';
+        return output;
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef JSONTOOLS_H
+#define JSONTOOLS_H
+
+// Вспомогательные функции для машиночитаемых отчётов в формате JSON
+#include <string>
+
+using namespace std;
+
+namespace jsontools {
+
+    // Возвращает строку в кавычках с экранированием по правилам JSON
+    string quote(const string& value);
+}
+
+#endif
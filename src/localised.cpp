@@ -0,0 +1,109 @@
+#include "localised.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace localised {
+
+    // Таблица кодов языков. Ячейки не перемещаются: код, номер которого
+    // выдан, читается без блокировки
+    static const size_t maxLanguages = 256;
+    static string codes[maxLanguages];
+    static atomic<size_t> codeCount{0};
+    static mutex codesMutex;
+
+    LanguageId intern(string_view code) {
+        size_t count = codeCount.load(memory_order_acquire);
+        for (size_t i = 0; i < count; i++) {
+            if (codes[i] == code) {
+                return static_cast<LanguageId>(i);
+            }
+        }
+        lock_guard<mutex> lock(codesMutex);
+        count = codeCount.load(memory_order_relaxed);
+        for (size_t i = 0; i < count; i++) {
+            if (codes[i] == code) {
+                return static_cast<LanguageId>(i);
+            }
+        }
+        if (count == maxLanguages) {
+            throw runtime_error("Слишком много кодов языков: " + string(code));
+        }
+        codes[count] = string(code);
+        codeCount.store(count + 1, memory_order_release);
+        return static_cast<LanguageId>(count);
+    }
+
+    const string& getCode(LanguageId id) {
+        return codes[id];
+    }
+
+    void String::readItem(size_t index, LanguageId& language, uint32_t& end) const {
+        const char* item = mData.data() + 1 + index * itemSize;
+        memcpy(&language, item, sizeof(language));
+        memcpy(&end, item + sizeof(language), sizeof(end));
+    }
+
+    size_t String::size() const {
+        return mData.empty() ? 0 : static_cast<unsigned char>(mData[0]);
+    }
+
+    bool String::empty() const {
+        return size() == 0;
+    }
+
+    bool String::find(string_view code, string_view& out) const {
+        bool found = false;
+        forEach([&](const string& language, string_view text) {
+            if (!found && language == code) {
+                out = text;
+                found = true;
+            }
+        });
+        return found;
+    }
+
+    void String::set(string_view code, string_view text) {
+        // Пересборка буфера: строки задаются только при разборе проекта
+        struct Item {
+            LanguageId language;
+            string_view text;
+        };
+        vector<Item> items;
+        items.reserve(size() + 1);
+        forEach([&](const string& language, string_view value) {
+            if (language != code) {
+                items.push_back({intern(language), value});
+            }
+        });
+        if (items.size() == maxLanguages - 1) {
+            throw runtime_error("Слишком много языков в строке");
+        }
+        LanguageId language = intern(code);
+        auto position = find_if(items.begin(), items.end(), [&](const Item& item) {
+            return getCode(item.language) > code;
+        });
+        items.insert(position, {language, text});
+
+        string data;
+        size_t total = 0;
+        for (const auto& item : items) {
+            total += item.text.size();
+        }
+        data.reserve(getTextOffset(items.size()) + total);
+        data += static_cast<char>(items.size());
+        uint32_t end = 0;
+        for (const auto& item : items) {
+            end += static_cast<uint32_t>(item.text.size());
+            data.append(reinterpret_cast<const char*>(&item.language), sizeof(item.language));
+            data.append(reinterpret_cast<const char*>(&end), sizeof(end));
+        }
+        for (const auto& item : items) {
+            data.append(item.text.data(), item.text.size());
+        }
+        mData = move(data);
+    }
+}
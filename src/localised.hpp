@@ -0,0 +1,68 @@
+#ifndef LOCALISED_H
+#define LOCALISED_H
+
+// Локализованная строка: тексты одной строки на нескольких языках
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+namespace localised {
+
+    // Номер кода языка в общей таблице кодов
+    using LanguageId = uint8_t;
+
+    // Номер кода языка, код добавляется в таблицу при первом обращении.
+    // Потокобезопасно
+    LanguageId intern(string_view code);
+
+    // Код языка по номеру
+    const string& getCode(LanguageId id);
+
+    // Тексты строки на разных языках в порядке кодов языков. Всё хранится в
+    // одном буфере: число языков, для каждого номер кода и конец текста,
+    // затем тексты подряд. Короткие строки не выделяют памяти вовсе
+    class String {
+        public:
+        // Задаёт текст на языке code, прежний текст на этом языке заменяется
+        void set(string_view code, string_view text);
+
+        // Текст на языке code. Возвращает false, если его нет
+        bool find(string_view code, string_view& out) const;
+
+        size_t size() const;
+        bool empty() const;
+
+        // Вызывает fn(код языка, текст) в порядке кодов
+        template <typename Fn>
+        void forEach(Fn&& fn) const {
+            size_t count = size();
+            size_t offset = getTextOffset(count);
+            size_t start = 0;
+            for (size_t i = 0; i < count; i++) {
+                LanguageId language;
+                uint32_t end;
+                readItem(i, language, end);
+                fn(getCode(language), string_view(mData.data() + offset + start, end - start));
+                start = end;
+            }
+        }
+
+        private:
+        // Размер записи языка: номер кода и конец текста
+        static const size_t itemSize = sizeof(LanguageId) + sizeof(uint32_t);
+
+        static size_t getTextOffset(size_t count) {
+            return 1 + count * itemSize;
+        }
+        void readItem(size_t index, LanguageId& language, uint32_t& end) const;
+
+        string mData;
+    };
+}
+
+using lstring = localised::String;
+
+#endif
@@ -0,0 +1,78 @@
+#include "logging.hpp"
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+#include <spdlog/async.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+namespace logging {
+
+    // Как часто выводить счётчик хода выполнения
+    static const int64_t reportInterval = chrono::nanoseconds(chrono::seconds(1)).count();
+
+    void setup(const string& level, bool quiet) {
+        auto parsed = spdlog::level::from_str(level);
+        // Неизвестные строки from_str превращает в off
+        if (parsed == spdlog::level::off && level != "off") {
+            throw runtime_error("Неизвестный уровень журнала: " + level);
+        }
+        if (quiet) {
+            parsed = max(parsed, spdlog::level::warn);
+        }
+
+        // Один фоновый поток сохраняет порядок сообщений. При переполнении
+        // очереди рабочие потоки ждут, сообщения не теряются
+        spdlog::init_thread_pool(8192, 1);
+        auto logger = spdlog::stdout_color_mt<spdlog::async_factory>("spb");
+        spdlog::set_default_logger(logger);
+        spdlog::set_level(parsed);
+    }
+
+    void shutdown() {
+        spdlog::shutdown();
+    }
+
+    Progress::Progress(string phase, size_t total)
+        : mPhase{move(phase)}
+        , mTotal{total}
+        , mStart{chrono::steady_clock::now()} {}
+
+    Progress::~Progress() {
+        // При ошибке итог этапа не нужен
+        if (uncaught_exceptions() > 0) {
+            return;
+        }
+        size_t done = mDone.load();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - mStart).count();
+        spdlog::info(
+            "{}: {} за {:.0f} мс ({:.0f} в секунду)",
+            mPhase,
+            done,
+            seconds * 1000,
+            seconds > 0 ? done / seconds : 0.0
+        );
+    }
+
+    void Progress::step() {
+        size_t done = ++mDone;
+        int64_t elapsed = chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now() - mStart
+        ).count();
+        int64_t last = mLastReport.load(memory_order_relaxed);
+        if (elapsed - last < reportInterval) {
+            return;
+        }
+        // Выводит только поток, успевший занять интервал
+        if (!mLastReport.compare_exchange_strong(last, elapsed, memory_order_relaxed)) {
+            return;
+        }
+        spdlog::info(
+            "{}: {}/{} ({:.0f} в секунду)",
+            mPhase,
+            done,
+            mTotal,
+            done / (elapsed / 1e9)
+        );
+    }
+}
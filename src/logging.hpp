@@ -0,0 +1,45 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+// Журнал сборки: асинхронный вывод и сводный ход выполнения этапов
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+namespace logging {
+
+    // Заменяет журнал по умолчанию асинхронным. level - уровень spdlog
+    // (trace, debug, info, warning, error, critical, off). quiet оставляет
+    // только предупреждения и ошибки
+    void setup(const string& level, bool quiet);
+
+    // Дописывает очередь сообщений и останавливает фоновый поток журнала
+    void shutdown();
+
+    // Ход выполнения этапа: вместо строки на каждый объект раз в секунду
+    // выводит счётчик, а по завершении - итог и скорость. step потокобезопасен
+    class Progress {
+        public:
+        Progress(string phase, size_t total);
+        ~Progress();
+        Progress(const Progress&) = delete;
+        Progress& operator=(const Progress&) = delete;
+
+        // Отмечает обработку одного объекта
+        void step();
+
+        private:
+        string mPhase;
+        size_t mTotal;
+        atomic<size_t> mDone{0};
+        chrono::steady_clock::time_point mStart;
+        // Время последнего вывода от начала этапа, наносекунды
+        atomic<int64_t> mLastReport{0};
+    };
+}
+
+#endif
@@ -0,0 +1,232 @@
+#include "memstats.hpp"
+#include "jsontools.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <malloc.h>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <vector>
+#include <pugixml.hpp>
+#include <spdlog/spdlog.h>
+
+namespace memstats {
+
+    static atomic<bool> enabled{false};
+    static atomic<uint64_t> allocations{0};
+    static atomic<uint64_t> allocatedBytes{0};
+    static atomic<int64_t> liveBytes{0};
+    static atomic<int64_t> peakLiveBytes{0};
+    static atomic<int64_t> domLiveBytes{0};
+
+    // Байт, выделенных pugixml в текущем потоке, нарастающим итогом
+    static thread_local uint64_t threadDomBytes = 0;
+    // Самый внутренний замер DOM текущего потока
+    static thread_local DomMeter* currentMeter = nullptr;
+
+    // Состояние памяти на границе этапа
+    struct PhaseUsage {
+        string phase;
+        uint64_t rss;
+        uint64_t peakRss;
+        HeapCounters heap;
+    };
+
+    static mutex dataMutex;
+    static vector<PhaseUsage> phases;
+    static vector<pair<string, uint64_t>> documents;
+
+    // Учитывает выделенный блок. Занятым считается фактический размер
+    // блока usable, чтобы освобождение вычитало ровно столько же
+    static void countAllocation(size_t size, int64_t usable) {
+        allocations.fetch_add(1, memory_order_relaxed);
+        allocatedBytes.fetch_add(size, memory_order_relaxed);
+        int64_t live = liveBytes.fetch_add(usable, memory_order_relaxed) + usable;
+        int64_t peak = peakLiveBytes.load(memory_order_relaxed);
+        while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live, memory_order_relaxed)) {}
+    }
+
+    // Перед блоком operator new лежит заголовок с учтённым размером блока:
+    // 0, если блок выделен до включения учёта. Такие блоки при
+    // освобождении не вычитаются, и живая куча не уходит в минус
+    static constexpr size_t headerSize = alignof(max_align_t);
+
+    void* allocate(size_t size) {
+        char* block = static_cast<char*>(malloc(headerSize + size));
+        if (block == nullptr) {
+            throw bad_alloc();
+        }
+        int64_t counted = 0;
+        if (enabled.load(memory_order_relaxed)) {
+            counted = malloc_usable_size(block);
+            countAllocation(size, counted);
+        }
+        *reinterpret_cast<int64_t*>(block) = counted;
+        return block + headerSize;
+    }
+
+    void deallocate(void* p) {
+        if (p == nullptr) {
+            return;
+        }
+        char* block = static_cast<char*>(p) - headerSize;
+        int64_t counted = *reinterpret_cast<int64_t*>(block);
+        if (counted != 0) {
+            liveBytes.fetch_sub(counted, memory_order_relaxed);
+        }
+        free(block);
+    }
+
+    // Выделения памяти внутри pugixml идут мимо operator new. Функции
+    // ставятся при включении учёта, поэтому учтены все их блоки
+    static void* pugiAllocate(size_t size) {
+        void* p = malloc(size);
+        if (p != nullptr) {
+            int64_t usable = malloc_usable_size(p);
+            countAllocation(size, usable);
+            domLiveBytes.fetch_add(usable, memory_order_relaxed);
+            threadDomBytes += size;
+        }
+        return p;
+    }
+
+    static void pugiDeallocate(void* p) {
+        if (p != nullptr) {
+            int64_t usable = malloc_usable_size(p);
+            liveBytes.fetch_sub(usable, memory_order_relaxed);
+            domLiveBytes.fetch_sub(usable, memory_order_relaxed);
+        }
+        free(p);
+    }
+
+    void enable() {
+        pugi::set_memory_management_functions(&pugiAllocate, &pugiDeallocate);
+        enabled = true;
+    }
+
+    bool isEnabled() {
+        return enabled.load(memory_order_relaxed);
+    }
+
+    HeapCounters getHeap() {
+        HeapCounters heap;
+        heap.allocations = allocations.load();
+        heap.allocatedBytes = allocatedBytes.load();
+        heap.liveBytes = liveBytes.load();
+        heap.peakLiveBytes = peakLiveBytes.load();
+        heap.domLiveBytes = domLiveBytes.load();
+        return heap;
+    }
+
+    void getRss(uint64_t& rss, uint64_t& peakRss) {
+        rss = 0;
+        peakRss = 0;
+        ifstream status("/proc/self/status");
+        string line;
+        while (getline(status, line)) {
+            // Строки вида "VmRSS:	  12345 kB"
+            if (line.compare(0, 6, "VmRSS:") == 0) {
+                rss = strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+            } else if (line.compare(0, 6, "VmHWM:") == 0) {
+                peakRss = strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+            }
+        }
+    }
+
+    void mark(const string& phase) {
+        if (!isEnabled()) {
+            return;
+        }
+        PhaseUsage usage{phase, 0, 0, getHeap()};
+        getRss(usage.rss, usage.peakRss);
+
+        // Пик кучи считается отдельно для каждого этапа
+        peakLiveBytes = liveBytes.load();
+
+        lock_guard<mutex> lock(dataMutex);
+        phases.push_back(usage);
+    }
+
+    DomMeter::DomMeter()
+        : mStart{threadDomBytes}
+        , mOuter{currentMeter}
+    {
+        currentMeter = this;
+    }
+
+    DomMeter::~DomMeter() {
+        currentMeter = mOuter;
+        if (mOuter != nullptr) {
+            mOuter->mNested += threadDomBytes - mStart;
+        }
+    }
+
+    uint64_t DomMeter::bytes() const {
+        return threadDomBytes - mStart - mNested;
+    }
+
+    DomMeter* DomMeter::current() {
+        return currentMeter;
+    }
+
+    void recordDocument(const string& path, uint64_t domBytes) {
+        if (!isEnabled()) {
+            return;
+        }
+        lock_guard<mutex> lock(dataMutex);
+        documents.emplace_back(path, domBytes);
+    }
+
+    // Байты в мегабайтах для сводки
+    static double toMb(int64_t bytes) {
+        return bytes / (1024.0 * 1024.0);
+    }
+
+    void write(fs::path path) {
+        lock_guard<mutex> lock(dataMutex);
+
+        for (const auto& p : phases) {
+            spdlog::info(
+                "Память: {}: RSS {:.1f} МБ (пик {:.1f} МБ), куча {:.1f} МБ (пик {:.1f} МБ), DOM {:.1f} МБ",
+                p.phase,
+                toMb(p.rss),
+                toMb(p.peakRss),
+                toMb(p.heap.liveBytes),
+                toMb(p.heap.peakLiveBytes),
+                toMb(p.heap.domLiveBytes)
+            );
+        }
+
+        ofstream out(path, ios::binary | ios::trunc);
+        if (!out) {
+            throw runtime_error("Не удалось открыть файл отчёта о памяти: " + path.string());
+        }
+
+        out << "{\n  \"phases\": [\n";
+        for (size_t i = 0; i < phases.size(); i++) {
+            const auto& p = phases[i];
+            out << "    {\"phase\": " << jsontools::quote(p.phase)
+                << ", \"rss_bytes\": " << p.rss
+                << ", \"peak_rss_bytes\": " << p.peakRss
+                << ", \"heap_live_bytes\": " << p.heap.liveBytes
+                << ", \"heap_peak_bytes\": " << p.heap.peakLiveBytes
+                << ", \"dom_live_bytes\": " << p.heap.domLiveBytes
+                << ", \"allocations\": " << p.heap.allocations
+                << ", \"allocated_bytes\": " << p.heap.allocatedBytes
+                << "}" << (i + 1 < phases.size() ? "," : "") << "\n";
+        }
+        out << "  ],\n  \"documents\": [\n";
+        for (size_t i = 0; i < documents.size(); i++) {
+            out << "    {\"path\": " << jsontools::quote(documents[i].first)
+                << ", \"dom_bytes\": " << documents[i].second
+                << "}" << (i + 1 < documents.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+
+        if (!out) {
+            throw runtime_error("Не удалось записать файл отчёта о памяти: " + path.string());
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+// Учёт памяти: RSS процесса, живая куча и память DOM pugixml по этапам сборки
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+namespace memstats {
+
+    // Счётчики кучи с момента включения учёта
+    struct HeapCounters {
+        // Выделений всего
+        uint64_t allocations = 0;
+        // Запрошено байт всего
+        uint64_t allocatedBytes = 0;
+        // Занято сейчас
+        int64_t liveBytes = 0;
+        // Наибольшее значение liveBytes
+        int64_t peakLiveBytes = 0;
+        // Из liveBytes занято DOM pugixml
+        int64_t domLiveBytes = 0;
+    };
+
+    // Включает учёт выделений: глобальные operator new/delete и функции
+    // выделения памяти pugixml. Вызывается в начале main, до разбора
+    // документов. Выделения через operator new учитываются, только если
+    // в программу скомпонован memstats_new.cpp (в spb - при сборке с
+    // -Dheap_accounting=true). Тогда каждый блок operator new несёт
+    // заголовок alignof(max_align_t) байт, даже если учёт не включён
+    void enable();
+
+    // Включён ли учёт
+    bool isEnabled();
+
+    // Выделение и освобождение памяти для замены operator new/delete
+    // (memstats_new.cpp). Освобождение вычитает только блоки, выделенные
+    // после включения учёта
+    void* allocate(size_t size);
+    void deallocate(void* p);
+
+    // Текущие счётчики кучи
+    HeapCounters getHeap();
+
+    // Текущий и пиковый RSS процесса в байтах (VmRSS и VmHWM)
+    void getRss(uint64_t& rss, uint64_t& peakRss);
+
+    // Запоминает состояние памяти на границе этапа
+    void mark(const string& phase);
+
+    // Замер памяти DOM, выделенной pugixml в текущем потоке за время жизни
+    // объекта. Вложенные замеры из результата внешнего исключаются
+    class DomMeter {
+        public:
+        DomMeter();
+        ~DomMeter();
+        DomMeter(const DomMeter&) = delete;
+        DomMeter& operator=(const DomMeter&) = delete;
+
+        // Байт DOM, выделенных с момента создания, без вложенных замеров
+        uint64_t bytes() const;
+
+        // Самый внутренний действующий замер текущего потока или nullptr
+        static DomMeter* current();
+
+        private:
+        uint64_t mStart;
+        uint64_t mNested = 0;
+        DomMeter* mOuter;
+    };
+
+    // Запоминает объём DOM выгруженного документа
+    void recordDocument(const string& path, uint64_t domBytes);
+
+    // Выводит сводку по этапам в лог и записывает все замеры в JSON
+    void write(fs::path path);
+}
+
+#endif
@@ -0,0 +1,30 @@
+// Замена глобальных operator new/delete для учёта выделений memstats.
+// Компонуется только в программы, которым нужен учёт кучи: замеры и spb,
+// собранный с -Dheap_accounting=true. Каждый блок, даже пока учёт не
+// включён, получает заголовок alignof(max_align_t) байт
+#include "memstats.hpp"
+#include <new>
+
+void* operator new(size_t size) {
+    return memstats::allocate(size);
+}
+
+void* operator new[](size_t size) {
+    return memstats::allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    memstats::deallocate(p);
+}
+
+void operator delete[](void* p) noexcept {
+    memstats::deallocate(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    memstats::deallocate(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    memstats::deallocate(p);
+}
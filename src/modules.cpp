@@ -0,0 +1,266 @@
+#include "modules.hpp"
+#include "xmltools.hpp"
+#include "textkernel.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+#include "logging.hpp"
+#include "placement.hpp"
+#include <atomic>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+
+namespace modules {
+
+    // Суффикс исходного файла и имя файла модуля в выгрузке
+    struct ModuleKind {
+        const char* suffix;
+        const char* fileName;
+    };
+
+    static const ModuleKind moduleKinds[] = {
+        {"_МодульОбъекта.super", "ObjectModule.bsl"},
+        {"_МодульМенеджера.super", "ManagerModule.bsl"}
+    };
+
+    string getTypeDirectory(const string& kind) {
+        if (kind == "Catalog") {
+            return "Catalogs";
+        }
+        if (kind == "Document") {
+            return "Documents";
+        }
+        throw logic_error("У объекта " + kind + " нет модулей");
+    }
+
+    void discover(
+        const fs::path& objectConfigPath,
+        const string& kind,
+        const string& name,
+        const fs::path& exportRoot,
+        vector<Module>& out)
+    {
+        fs::path directory = objectConfigPath.parent_path();
+        string stem = objectConfigPath.stem().string();
+        fs::path ext = exportRoot / getTypeDirectory(kind) / name / "Ext";
+        for (const auto& moduleKind : moduleKinds) {
+            fs::path source = directory / (stem + moduleKind.suffix);
+            if (fs::is_regular_file(source)) {
+                out.push_back({source, ext / moduleKind.fileName});
+            }
+        }
+    }
+
+    // Приводит слово к нижнему регистру: латиница и кириллица в UTF-8
+    static string foldCase(const char* data, size_t size) {
+        string out(data, size);
+        for (size_t i = 0; i < out.size(); i++) {
+            unsigned char c = out[i];
+            if (c >= 'A' && c <= 'Z') {
+                out[i] = c + 32;
+            } else if (c == 0xD0 && i + 1 < out.size()) {
+                unsigned char next = out[i + 1];
+                if (next >= 0x90 && next <= 0x9F) {
+                    // А-П
+                    out[i + 1] = next + 0x20;
+                } else if (next >= 0xA0 && next <= 0xAF) {
+                    // Р-Я
+                    out[i] = '\xD1';
+                    out[i + 1] = next - 0x20;
+                } else if (next == 0x81) {
+                    // Ё
+                    out[i] = '\xD1';
+                    out[i + 1] = '\x91';
+                }
+                i++;
+            }
+        }
+        return out;
+    }
+
+    // Объявление: 0 - не объявление, 1 - процедура, 2 - функция.
+    // Отрицательное значение - конец соответствующего объявления
+    static int getDeclaration(const string& word) {
+        if (word == "процедура" || word == "procedure") {
+            return 1;
+        }
+        if (word == "функция" || word == "function") {
+            return 2;
+        }
+        if (word == "конецпроцедуры" || word == "endprocedure") {
+            return -1;
+        }
+        if (word == "конецфункции" || word == "endfunction") {
+            return -2;
+        }
+        return 0;
+    }
+
+    static bool isWordByte(unsigned char c) {
+        return (c >= 'a' && c <= 'z')
+            || (c >= 'A' && c <= 'Z')
+            || (c >= '0' && c <= '9')
+            || c == '_'
+            || c >= 0x80;
+    }
+
+    void validate(const string& text, const string& sourceName) {
+        if (!textkernel::isValidUtf8(text.data(), text.size())) {
+            throw runtime_error("Некорректный UTF-8 в модуле: " + sourceName);
+        }
+
+        auto fail = [&](size_t line, const string& message) {
+            throw runtime_error(sourceName + ":" + to_string(line) + ": " + message);
+        };
+
+        size_t line = 1;
+        // Открытое объявление и строка, где оно начато
+        int open = 0;
+        size_t openLine = 0;
+        string openWord;
+        // Последний значимый символ: слово после точки - имя свойства
+        char previous = '\n';
+
+        size_t i = 0;
+        size_t size = text.size();
+        // Конфигуратор и EDT пишут модули с BOM, иначе он прилип бы к
+        // первому слову
+        if (text.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+            i = 3;
+        }
+        while (i < size) {
+            char c = text[i];
+            if (c == '\n') {
+                line++;
+                previous = c;
+                i++;
+            } else if (c == ' ' || c == '\t' || c == '\r') {
+                i++;
+            } else if (c == '/' && i + 1 < size && text[i + 1] == '/') {
+                // Комментарий до конца строки
+                while (i < size && text[i] != '\n') {
+                    i++;
+                }
+            } else if ((c == '#' || c == '&') && previous == '\n') {
+                // Инструкции препроцессора и аннотации занимают строку целиком
+                while (i < size && text[i] != '\n') {
+                    i++;
+                }
+            } else if (c == '"') {
+                // Строка; "" внутри - кавычка, перевод строки продолжает литерал
+                size_t startLine = line;
+                i++;
+                while (true) {
+                    if (i >= size) {
+                        fail(startLine, "незакрытая строка");
+                    }
+                    if (text[i] == '"') {
+                        if (i + 1 < size && text[i + 1] == '"') {
+                            i += 2;
+                            continue;
+                        }
+                        i++;
+                        break;
+                    }
+                    if (text[i] == '\n') {
+                        line++;
+                    }
+                    i++;
+                }
+                previous = '"';
+            } else if (isWordByte(c)) {
+                size_t start = i;
+                while (i < size && isWordByte(text[i])) {
+                    i++;
+                }
+                // Длиннее всех ключевых слов ("конецпроцедуры" - 28 байт)
+                // слова не сравниваются
+                int declaration = previous == '.' || i - start > 28
+                    ? 0
+                    : getDeclaration(foldCase(text.data() + start, i - start));
+                if (declaration != 0) {
+                    string word = text.substr(start, i - start);
+                    if (declaration > 0) {
+                        if (open != 0) {
+                            fail(line, word + " внутри " + openWord + " (строка " + to_string(openLine) + ")");
+                        }
+                        open = declaration;
+                        openLine = line;
+                        openWord = word;
+                    } else {
+                        if (open != -declaration) {
+                            fail(line, word + " без парного объявления");
+                        }
+                        open = 0;
+                    }
+                }
+                previous = 'a';
+            } else {
+                previous = c;
+                i++;
+            }
+        }
+
+        if (open != 0) {
+            fail(openLine, "не закрыто объявление " + openWord);
+        }
+    }
+
+    // Собирает один модуль. Возвращает false, если модуль не изменился
+    static bool buildModule(const Module& module, buildcache::Cache* cache, placement::Mode mode) {
+        trace::Span span("modules", "buildModule", module.source.string());
+        string key = fs::absolute(module.target).lexically_normal().string();
+
+        buildcache::Stamp sourceStamp;
+        if (!buildcache::getStamp(module.source, sourceStamp)) {
+            throw runtime_error("Не удалось прочитать модуль: " + module.source.string());
+        }
+        buildcache::Record cached;
+        bool known = cache != nullptr && cache->find(key, cached);
+        bool sourceIntact = known && cached.source == sourceStamp;
+        buildcache::Stamp targetStamp;
+        bool targetIntact = known
+            && buildcache::getStamp(module.target, targetStamp)
+            && cached.target == targetStamp;
+
+        // Ни исходный, ни выходной файл не трогали: не читаем ничего
+        if (sourceIntact && targetIntact) {
+            return false;
+        }
+
+        // Исходный файл прочитан и проверен при прошлой сборке
+        uint64_t hash = cached.hash;
+        if (!sourceIntact) {
+            string text = xmltools::readFile(module.source);
+            hash = buildcache::hashContent(text.data(), text.size());
+            // Содержимое с таким хэшем уже проверялось
+            if (!(known && cached.hash == hash)) {
+                validate(text, module.source.string());
+            }
+        }
+
+        // Модуль попадает в выгрузку без изменений
+        auto outcome = placement::placeFile(module.source, module.target, mode);
+        spdlog::debug("Модуль: {} ({})", module.target.string(), placement::getOutcomeName(outcome));
+        if (cache != nullptr) {
+            buildcache::getStamp(module.target, targetStamp);
+            cache->put(key, {sourceStamp, hash, targetStamp});
+        }
+        return outcome != placement::Outcome::Unchanged;
+    }
+
+    Result build(const vector<Module>& modules, buildcache::Cache* cache, placement::Mode mode) {
+        logging::Progress progress("Модули", modules.size());
+        atomic<size_t> built{0};
+        parallel::forEach(modules.size(), [&](size_t i) {
+            if (buildModule(modules[i], cache, mode)) {
+                built++;
+            }
+            progress.step();
+        });
+
+        Result result;
+        result.built = built;
+        result.unchanged = modules.size() - result.built;
+        return result;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef MODULES_H
+#define MODULES_H
+
+// Модули объектов. Файлы <Имя>_МодульОбъекта.super и
+// <Имя>_МодульМенеджера.super лежат рядом с файлом настроек объекта и
+// попадают в выгрузку как Ext/ObjectModule.bsl и Ext/ManagerModule.bsl
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "buildcache.hpp"
+#include "placement.hpp"
+
+namespace fs = std::filesystem;
+using namespace std;
+
+namespace modules {
+
+    // Модуль, найденный в проекте
+    struct Module {
+        // Исходный файл в проекте
+        fs::path source;
+        // Файл в каталоге выгрузки
+        fs::path target;
+    };
+
+    // Каталог выгрузки для вида объекта: Catalogs, Documents
+    string getTypeDirectory(const string& kind);
+
+    // Добавляет в out модули объекта kind ("Catalog", "Document") с именем
+    // name, найденные рядом с файлом настроек objectConfigPath
+    void discover(
+        const fs::path& objectConfigPath,
+        const string& kind,
+        const string& name,
+        const fs::path& exportRoot,
+        vector<Module>& out);
+
+    // Проверяет текст модуля: корректный UTF-8 и парность объявлений
+    // процедур и функций. При ошибке бросает runtime_error с номером строки
+    void validate(const string& text, const string& sourceName);
+
+    // Итог этапа модулей
+    struct Result {
+        // Размещено в выгрузке заново
+        size_t built = 0;
+        // Не изменились с прошлой сборки
+        size_t unchanged = 0;
+    };
+
+    // Собирает модули на рабочих потоках и размещает их в выгрузке
+    // способом mode. cache может быть nullptr: тогда все модули
+    // проверяются заново
+    Result build(const vector<Module>& modules, buildcache::Cache* cache, placement::Mode mode);
+}
+
+#endif
@@ -2,6 +2,12 @@
 #include <iostream>
 #include "xmltools.hpp"
 #include "ids.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+#include "report.hpp"
+#include "memstats.hpp"
+#include "logging.hpp"
+#include "templates.hpp"
 #include <spdlog/spdlog.h>
 
 namespace objects {
@@ -15,7 +21,7 @@ namespace objects {
         shared_ptr<ObjectNode> parent
     )
         : mName{name}
-        , mSynonym{synonym}
+        , mSynonym{move(synonym)}
         , mComment{comment}
         , mParent{parent}
         , mVersion{version} {}
@@ -27,17 +33,108 @@ namespace objects {
         return output;
     }
 
+    // Количество элементов в тексте документа: открывающих тегов. Символ <
+    // в тексте и атрибутах экранирован, поэтому других < в выгрузке нет
+    static size_t countElements(const string& text) {
+        size_t count = 0;
+        size_t pos = text.find('<');
+        while (pos != string::npos) {
+            if (pos + 1 < text.size()) {
+                char next = text[pos + 1];
+                count += next != '/' && next != '?' && next != '!';
+            }
+            pos = text.find('<', pos + 1);
+        }
+        return count;
+    }
+
+    void ObjectNode::saveDocument(const pugi::xml_document& doc, const fs::path& path) {
+        string text;
+        try {
+            xmltools::serializeDocument(doc, text);
+        } catch (const runtime_error& e) {
+            throw runtime_error(path.string() + ": " + e.what());
+        }
+        saveText(text, path);
+    }
+
+    void ObjectNode::saveText(const string& text, const fs::path& path) {
+        trace::Span span("write", "saveDocument", mName);
+        xmltools::writeFile(text, path);
+
+        // Память DOM документа: всё, что pugixml выделил с начала выгрузки объекта
+        auto meter = memstats::DomMeter::current();
+        uint64_t domBytes = meter != nullptr ? meter->bytes() : 0;
+        memstats::recordDocument(path.string(), domBytes);
+
+        if (report::isEnabled()) {
+            size_t elements = countElements(text);
+            report::update(getQualifiedName(), [&](report::ObjectStats& s) {
+                s.elements += elements;
+                s.domBytes += domBytes;
+                s.bytesWritten += text.size();
+            });
+        }
+    }
+
     std::string ObjectNode::getName() {
         return mName;
     }
 
-    lstring ObjectNode::getSynonym() {
+    const lstring& ObjectNode::getSynonym() {
         return mSynonym;
     }
 
     std::string ObjectNode::getComment() {
         return mComment;
     }
+
+    void ObjectNode::collectReferences(vector<validation::Reference>& out) {
+        (void)out;
+    }
+
+    // Добавляет ссылку, если тип является ссылочным
+    static void collectTypeReference(
+        vector<validation::Reference>& out,
+        const string& owner,
+        const shared_ptr<typing::Type>& type)
+    {
+        auto ref = dynamic_pointer_cast<typing::Ref>(type);
+        if (ref) {
+            out.push_back({owner, ref->getClassId(), ref->getTargetName()});
+        }
+    }
+
+    // Выводит реквизит или колонку табличной части по шаблону
+    static void renderAttribute(
+        string& out,
+        size_t depth,
+        const string& qualifiedName,
+        const string& name,
+        const lstring& synonym,
+        const string& comment,
+        typing::Type& type)
+    {
+        templates::getAttribute().render(out, depth, [&](string& out, size_t slot, size_t depth) {
+            switch (static_cast<templates::AttributeSlot>(slot)) {
+                case templates::AttributeSlot::Uuid:
+                    out += ids::getUUIDFor(qualifiedName);
+                    break;
+                case templates::AttributeSlot::Name:
+                    templates::appendSubNode(out, "Name", name);
+                    break;
+                case templates::AttributeSlot::Synonym:
+                    templates::appendLocalisedString(out, depth, "Synonym", synonym);
+                    break;
+                case templates::AttributeSlot::Comment:
+                    templates::appendSubNode(out, "Comment", comment);
+                    break;
+                case templates::AttributeSlot::Type:
+                    templates::appendType(out, depth, type);
+                    break;
+            }
+        });
+    }
     //=====================================//
 
     //==========Реквизит==========//
@@ -48,31 +145,25 @@ namespace objects {
         string version,
         shared_ptr<typing::Type> type,
         shared_ptr<ObjectNode> parent)
-        : ObjectNode{name, synonym, comment, version, parent}
+        : ObjectNode{name, move(synonym), comment, version, parent}
         , mType{type} {}
 
     void Property::exportToFiles(fs::path exportRoot) { (void)exportRoot; }
 
-    pugi::xml_node Property::makeNode(pugi::xml_node md) {
-        auto output         = md.append_child("Attribute");
-        auto outputProps    = output.append_child("Properties");
-        
-        output.append_attribute("uuid").set_value(ids::getUUIDFor(getQualifiedName()));
-
-        xmltools::addNameNode(outputProps, mName);
-        xmltools::addLocalisedString(outputProps.append_child("Synonym"), mSynonym);
-        xmltools::addCommentNode(outputProps, mComment);
-        mType->addTypeNode(outputProps);
-        
-        return output;
+    void Property::renderNode(string& out, size_t depth) {
+        renderAttribute(out, depth, getQualifiedName(), mName, mSynonym, mComment, *mType);
     }
 
     string Property::getQualifiedName() {
-        return mParent->getQualifiedName() + ".Attribute." + mName;
+        return mParent.lock()->getQualifiedName() + ".Attribute." + mName;
+    }
+
+    void Property::generateConfigVersions(versions::Shard& shard) {
+        shard.add(getQualifiedName(), mVersion);
     }
 
-    void Property::generateConfigVersions(pugi::xml_node parent) {
-        xmltools::addConfigVersion(parent, getQualifiedName(), mVersion);
+    void Property::collectReferences(vector<validation::Reference>& out) {
+        collectTypeReference(out, getQualifiedName(), mType);
     }
     //============================//
     
@@ -109,37 +200,27 @@ namespace objects {
         string version,
         shared_ptr<TabularSection> parent,
         shared_ptr<typing::Type> type)
-        : ObjectNode{name, synonym, comment, version, parent}
+        : ObjectNode{name, move(synonym), comment, version, parent}
         , mType{type} {}
 
     void TabularColumn::exportToFiles(fs::path exportRoot) {
         (void)exportRoot;
     }
-
-    pugi::xml_node TabularColumn::makeNode(pugi::xml_node md) {
-        auto output   = md.append_child("Attribute");
-        auto colProps = output.append_child("Properties");
-
-        output.append_attribute("uuid").set_value(ids::getUUIDFor(getQualifiedName()));
-
-        xmltools::addNameNode(colProps, mName);
-        xmltools::addLocalisedString(colProps.append_child("Synonym"), mSynonym);
-        xmltools::addCommentNode(colProps, mComment);
-        mType->addTypeNode(colProps);
-
-        return output;
-    }
     
+    void TabularColumn::renderNode(string& out, size_t depth) {
+        renderAttribute(out, depth, getQualifiedName(), mName, mSynonym, mComment, *mType);
+    }
+
     string TabularColumn::getQualifiedName() {
-        return mParent->getQualifiedName() + ".Attribute." + mName;
+        return mParent.lock()->getQualifiedName() + ".Attribute." + mName;
     }
 
-    void TabularColumn::generateConfigVersions(pugi::xml_node parent) {
-        xmltools::addConfigVersion(
-            parent,
-            getQualifiedName(),
-            mVersion
-        );
+    void TabularColumn::generateConfigVersions(versions::Shard& shard) {
+        shard.add(getQualifiedName(), mVersion);
+    }
+
+    void TabularColumn::collectReferences(vector<validation::Reference>& out) {
+        collectTypeReference(out, getQualifiedName(), mType);
     }
     //===========================================//
 
@@ -151,7 +232,7 @@ namespace objects {
         string version,
         shared_ptr<ObjectNode> parent,
         string generatedTypePrefix)
-        : ObjectNode{name, synonym, comment, version, parent}
+        : ObjectNode{name, move(synonym), comment, version, parent}
         , mColumns{}
         , mGeneratedTypePrefix{generatedTypePrefix} {}
     
@@ -159,57 +240,80 @@ namespace objects {
         (void)exportRoot;
     }
 
-    pugi::xml_node TabularSection::makeNode(pugi::xml_node md) {
-        auto output         = md.append_child("TabularSection");
-        output.append_attribute("uuid").set_value(ids::getUUIDFor(getQualifiedName()));
-
-        auto internalInfo   = output.append_child("InternalInfo");
-        auto properties     = output.append_child("Properties");
-        auto children       = output.append_child("ChildObjects");
-
-        // InternalInfo
-        xmltools::addGeneratedType(
-            internalInfo,
-            mGeneratedTypePrefix + "TabularSection." + mParent->getName() + "." + mName,
-            "TabularSection"
-        );
-        xmltools::addGeneratedType(
-            internalInfo,
-            mGeneratedTypePrefix + "TabularSectionRow." + mParent->getName() + "." + mName,
-            "TabularSectionRow"
-        );
+    void TabularSection::renderNode(string& out, size_t depth) {
+        string parentName = mParent.lock()->getName();
+        templates::getTabularSection().render(out, depth, [&](string& out, size_t slot, size_t depth) {
+            switch (static_cast<templates::TabularSlot>(slot)) {
+                case templates::TabularSlot::Uuid:
+                    out += ids::getUUIDFor(getQualifiedName());
+                    break;
+                case templates::TabularSlot::TypeName:
+                    xmltools::appendEscaped(
+                        out,
+                        mGeneratedTypePrefix + "TabularSection." + parentName + "." + mName,
+                        true
+                    );
+                    break;
+                case templates::TabularSlot::RowTypeName:
+                    xmltools::appendEscaped(
+                        out,
+                        mGeneratedTypePrefix + "TabularSectionRow." + parentName + "." + mName,
+                        true
+                    );
+                    break;
+                case templates::TabularSlot::RandomUuid:
+                    out += ids::getUUID();
+                    break;
+                case templates::TabularSlot::Name:
+                    templates::appendSubNode(out, "Name", mName);
+                    break;
+                case templates::TabularSlot::Synonym:
+                    templates::appendLocalisedString(out, depth, "Synonym", mSynonym);
+                    break;
+                case templates::TabularSlot::Comment:
+                    templates::appendSubNode(out, "Comment", mComment);
+                    break;
+                case templates::TabularSlot::Children:
+                    if (mColumns.empty()) {
+                        out += "<ChildObjects />";
+                        break;
+                    }
+                    out += "<ChildObjects>";
+                    for (auto col : mColumns) {
+                        templates::appendLineBreak(out, depth + 1);
+                        col->renderNode(out, depth + 1);
+                    }
+                    templates::appendLineBreak(out, depth);
+                    out += "</ChildObjects>";
+                    break;
+            }
+        });
+    }
 
-        // Свойства табличной части
-        xmltools::addNameNode(properties, mName);
-        xmltools::addLocalisedString(properties.append_child("Synonym"), mSynonym);
-        xmltools::addCommentNode(properties, mComment);
+    string TabularSection::getQualifiedName() {
+        return mParent.lock()->getQualifiedName() + ".TabularSection." + mName;
+    }
 
-        // Колонки табличной части
+    void TabularSection::generateConfigVersions(versions::Shard& shard) {
+        shard.add(getQualifiedName(), mVersion);
         for (auto col : mColumns) {
-            col->makeNode(children);
+            col->generateConfigVersions(shard);
         }
-        
-        return output;
     }
 
-    string TabularSection::getQualifiedName() {
-        return mParent->getQualifiedName() + ".TabularSection." + mName;
-    }
-
-    void TabularSection::generateConfigVersions(pugi::xml_node parent) {
-        xmltools::addConfigVersion(
-            parent,
-            getQualifiedName(),
-            mVersion
-        );
+    void TabularSection::collectReferences(vector<validation::Reference>& out) {
         for (auto col : mColumns) {
-            col->generateConfigVersions(parent);
+            col->collectReferences(out);
         }
     }
 
     void TabularSection::addColumn(shared_ptr<TabularColumn> column) {
         mColumns.push_back(column);
     }
+
+    size_t TabularSection::getColumnCount() {
+        return mColumns.size();
+    }
     //===================================//
 
     //==========Список реквизитов==========//
@@ -222,17 +326,30 @@ namespace objects {
         mProperties.push_back(p);
     }
 
-    void PropertyList::addNodesForAll(pugi::xml_node parent) {
+    void PropertyList::renderForAll(string& out, size_t depth) {
         for (auto p : mProperties) {
-            p->makeNode(parent);
+            templates::appendLineBreak(out, depth);
+            p->renderNode(out, depth);
         }
     }
 
     void PropertyList::addConfigVersionForAll(
-        pugi::xml_node parent
+        versions::Shard& shard
+    ) {
+        for (auto p : mProperties) {
+            p->generateConfigVersions(shard);
+        }
+    }
+
+    size_t PropertyList::size() {
+        return mProperties.size();
+    }
+
+    void PropertyList::collectReferencesForAll(
+        vector<validation::Reference>& out
     ) {
         for (auto p : mProperties) {
-            p->generateConfigVersions(parent);
+            p->collectReferences(out);
         }
     }
     //=====================================//
@@ -246,19 +363,38 @@ namespace objects {
         mTabulars.push_back(ts);
     }
 
-    void TabularsList::addNodesForAll(
-        pugi::xml_node parent
-    ) {
+    void TabularsList::renderForAll(string& out, size_t depth) {
         for (auto ts : mTabulars) {
-            ts->makeNode(parent);
+            templates::appendLineBreak(out, depth);
+            ts->renderNode(out, depth);
         }
     }
 
     void TabularsList::addConfigVersionForAll(
-        pugi::xml_node parent
+        versions::Shard& shard
     ) {
         for (auto ts : mTabulars) {
-            ts->generateConfigVersions(parent);
+            ts->generateConfigVersions(shard);
+        }
+    }
+
+    size_t TabularsList::size() {
+        return mTabulars.size();
+    }
+
+    size_t TabularsList::columnCount() {
+        size_t count = 0;
+        for (auto ts : mTabulars) {
+            count += ts->getColumnCount();
+        }
+        return count;
+    }
+
+    void TabularsList::collectReferencesForAll(
+        vector<validation::Reference>& out
+    ) {
+        for (auto ts : mTabulars) {
+            ts->collectReferences(out);
         }
     }
     //===========================================//
@@ -272,7 +408,7 @@ namespace objects {
         shared_ptr<Configuration> parent,
         string code
     )
-        : ObjectNode{name, synonym, comment, version, parent }
+        : ObjectNode{name, move(synonym), comment, version, parent }
         , mCode{code} {}
 
     string Language::getQualifiedName() {
@@ -280,30 +416,190 @@ namespace objects {
     }
 
     void Language::exportToFiles(fs::path exportRoot) {
-        auto doc    = ObjectNode::createDocument();
-        auto obj    = this->makeNode(doc.child("MetaDataObject"));
-        auto props  = obj.append_child("Properties");
+        trace::Span span("export", "Language", mName);
+        report::Timer timer(getQualifiedName(), &report::ObjectStats::exportSeconds);
+        memstats::DomMeter domMeter;
+        string text;
+        try {
+            templates::getLanguage().render(text, 0, [&](string& out, size_t slot, size_t depth) {
+                switch (static_cast<templates::LanguageSlot>(slot)) {
+                    case templates::LanguageSlot::Uuid:
+                        out += ids::getUUIDFor(getQualifiedName());
+                        break;
+                    case templates::LanguageSlot::Name:
+                        templates::appendSubNode(out, "Name", mName);
+                        break;
+                    case templates::LanguageSlot::Synonym:
+                        templates::appendLocalisedString(out, depth, "Synonym", mSynonym);
+                        break;
+                    case templates::LanguageSlot::Comment:
+                        templates::appendSubNode(out, "Comment", mComment);
+                        break;
+                    case templates::LanguageSlot::Code:
+                        templates::appendSubNode(out, "LanguageCode", mCode);
+                        break;
+                }
+            });
+        } catch (const runtime_error& e) {
+            throw runtime_error(getQualifiedName() + ": " + e.what());
+        }
 
-        xmltools::addNameNode(props, mName);
-        xmltools::addLocalisedString(props.append_child("Synonym"), mSynonym);
-        xmltools::addCommentNode(props, mComment);
-        xmltools::addSubNode(props, "LanguageCode", mCode);
+        saveText(text, exportRoot / "Languages" / (mName + ".xml"));
+        spdlog::debug("Выгружено: язык: {}", mName);
+    }
+
+    void Language::generateConfigVersions(versions::Shard& shard) {
+        shard.add(getQualifiedName(), mVersion);
+    }
+
+    string Language::getCode() {
+        return mCode;
+    }
+    //========================//
+
+    //==========Заимствованный язык==========//
+    AdoptedLanguage::AdoptedLanguage(
+        shared_ptr<Language> original,
+        shared_ptr<Configuration> extension
+    )
+        : Language{original->getName(), {}, "", "", extension, original->getCode()}
+        , mExtendedObject{ids::getUUIDFor(original->getQualifiedName())}
+        , mExtensionName{extension->getName()} {}
 
-        doc.save_file((exportRoot / "Languages" / (mName + ".xml")).c_str());
-        spdlog::info("Выгружено: язык: {}", mName);
+    string AdoptedLanguage::getUUID() {
+        return ids::getUUIDFor(mExtensionName + "." + getQualifiedName());
     }
 
-    pugi::xml_node Language::makeNode(pugi::xml_node md) {
+    void AdoptedLanguage::exportToFiles(fs::path exportRoot) {
+        trace::Span span("export", "AdoptedLanguage", mName);
+        auto doc = ObjectNode::createDocument();
+        auto obj = this->makeNode(doc.child("MetaDataObject"));
+        obj.append_child("InternalInfo");
+        auto properties = obj.append_child("Properties");
+        xmltools::addSubNode(properties, "ObjectBelonging", "Adopted");
+        xmltools::addNameNode(properties, mName);
+        xmltools::addCommentNode(properties, "");
+        xmltools::addSubNode(properties, "ExtendedConfigurationObject", mExtendedObject);
+        xmltools::addSubNode(properties, "LanguageCode", mCode);
+        saveDocument(doc, exportRoot / "Languages" / (mName + ".xml"));
+        spdlog::debug("Выгружено: заимствованный язык: {}", mName);
+    }
+
+    pugi::xml_node AdoptedLanguage::makeNode(pugi::xml_node md) {
         auto output = md.append_child("Language");
+        output.append_attribute("uuid").set_value(getUUID().c_str());
+        return output;
+    }
+
+    void AdoptedLanguage::generateConfigVersions(versions::Shard& shard) {
+        shard.add(getQualifiedName(), mVersion, getUUID());
+    }
+    //========================//
+
+    //==========Элемент стиля==========//
+    StyleItem::StyleItem(
+        string name,
+        string type,
+        vector<pair<string, string>> value,
+        shared_ptr<Configuration> parent
+    )
+        : ObjectNode{name, {}, "", "", parent }
+        , mType{type}
+        , mValue{value} {}
+
+    string StyleItem::getQualifiedName() {
+        return "StyleItem." + mName;
+    }
+
+    void StyleItem::exportToFiles(fs::path exportRoot) {
+        trace::Span span("export", "StyleItem", mName);
+        memstats::DomMeter domMeter;
+        auto doc = ObjectNode::createDocument();
+        auto obj = this->makeNode(doc.child("MetaDataObject"));
+        auto properties = obj.append_child("Properties");
+
+        xmltools::addNameNode(properties, mName);
+        xmltools::addLocalisedString(properties.append_child("Synonym"), mSynonym);
+        xmltools::addCommentNode(properties, mComment);
+        xmltools::addSubNode(properties, "Type", mType);
+
+        auto value = properties.append_child("Value");
+        value.append_attribute("xsi:type").set_value(("v8ui:" + mType).c_str());
+        for (const auto& it : mValue) {
+            if (it.first == "value") {
+                value.text().set(it.second.c_str());
+            } else {
+                value.append_attribute(it.first.c_str()).set_value(it.second.c_str());
+            }
+        }
+
+        saveDocument(doc, exportRoot / "StyleItems" / (mName + ".xml"));
+        spdlog::debug("Выгружено: элемент стиля: {}", mName);
+    }
+
+    pugi::xml_node StyleItem::makeNode(pugi::xml_node md) {
+        auto output = md.append_child("StyleItem");
         output.append_attribute("uuid").set_value(ids::getUUIDFor(getQualifiedName()));
         return output;
     }
 
-    void Language::generateConfigVersions(pugi::xml_node parent) {
-        xmltools::addConfigVersion(parent, getQualifiedName(), mVersion);
+    void StyleItem::generateConfigVersions(versions::Shard& shard) {
+        shard.add(getQualifiedName(), mVersion);
     }
     //========================//
 
+    // Выводит файл справочника или документа по шаблону: внутренняя
+    // информация, свойства, реквизиты и табличные части
+    static void renderObject(
+        string& out,
+        const string& kind,
+        const string& qualifiedName,
+        const string& name,
+        const lstring& synonym,
+        const string& comment,
+        PropertyList& properties,
+        TabularsList& tabulars,
+        const vector<string>& forms)
+    {
+        templates::getObject(kind).render(out, 0, [&](string& out, size_t slot, size_t depth) {
+            switch (static_cast<templates::ObjectSlot>(slot)) {
+                case templates::ObjectSlot::Uuid:
+                    out += ids::getUUIDFor(qualifiedName);
+                    break;
+                case templates::ObjectSlot::TypeName:
+                    xmltools::appendEscaped(out, name, true);
+                    break;
+                case templates::ObjectSlot::RandomUuid:
+                    out += ids::getUUID();
+                    break;
+                case templates::ObjectSlot::Name:
+                    templates::appendSubNode(out, "Name", name);
+                    break;
+                case templates::ObjectSlot::Synonym:
+                    templates::appendLocalisedString(out, depth, "Synonym", synonym);
+                    break;
+                case templates::ObjectSlot::Comment:
+                    templates::appendSubNode(out, "Comment", comment);
+                    break;
+                case templates::ObjectSlot::Children:
+                    if (properties.size() == 0 && tabulars.size() == 0 && forms.empty()) {
+                        out += "<ChildObjects />";
+                        break;
+                    }
+                    out += "<ChildObjects>";
+                    properties.renderForAll(out, depth + 1);
+                    tabulars.renderForAll(out, depth + 1);
+                    for (const auto& form : forms) {
+                        templates::appendLineBreak(out, depth + 1);
+                        templates::appendSubNode(out, "Form", form);
+                    }
+                    templates::appendLineBreak(out, depth);
+                    out += "</ChildObjects>";
+                    break;
+            }
+        });
+    }
+
     //==========Документ==========//
     Document::Document(
         string name,
@@ -312,52 +608,44 @@ namespace objects {
         string version,
         shared_ptr<Configuration> parent
     )
-        : ObjectNode{name, synonym, comment, version, parent } {}
+        : ObjectNode{name, move(synonym), comment, version, parent } {}
 
     string Document::getQualifiedName() {
         return "Document." + mName;
     }
 
     void Document::exportToFiles(fs::path exportRoot) {
-        auto doc    = ObjectNode::createDocument();
-        auto obj    = this->makeNode(doc.child("MetaDataObject"));
-        
-        auto internalInfo   = obj.append_child("InternalInfo");
-        auto properties     = obj.append_child("Properties");
-        auto children       = obj.append_child("ChildObjects");
-
-        // Внутренняя информация
-        xmltools::addGeneratedType(internalInfo, "DocumentObject."+mName, "Object");
-        xmltools::addGeneratedType(internalInfo, "DocumentRef."+mName, "Ref");
-        xmltools::addGeneratedType(internalInfo, "DocumentSelection."+mName, "Selection");
-        xmltools::addGeneratedType(internalInfo, "DocumentList."+mName, "List");
-        xmltools::addGeneratedType(internalInfo, "DocumentManager."+mName, "Manager");
-
-        // Свойства
-        xmltools::addNameNode(properties, mName);
-        xmltools::addLocalisedString(properties.append_child("Synonym"), mSynonym);
-        xmltools::addCommentNode(properties, mComment);
-
-        // Реквизиты
-        mProperties->addNodesForAll(children);
+        trace::Span span("export", "Document", mName);
+        report::Timer timer(getQualifiedName(), &report::ObjectStats::exportSeconds);
+        memstats::DomMeter domMeter;
+        string text;
+        try {
+            renderObject(text, "Document", getQualifiedName(), mName, mSynonym, mComment, *mProperties, *mTabulars, mForms);
+        } catch (const runtime_error& e) {
+            throw runtime_error(getQualifiedName() + ": " + e.what());
+        }
 
-        // Табличные части
-        mTabulars->addNodesForAll(children);
+        report::update(getQualifiedName(), [&](report::ObjectStats& s) {
+            s.attributes = mProperties->size();
+            s.columns = mTabulars->columnCount();
+        });
 
-        doc.save_file((exportRoot / "Documents" / (mName + ".xml")).c_str());
-        spdlog::info("Выгружено: документ: {}", mName);
+        saveText(text, exportRoot / "Documents" / (mName + ".xml"));
+        spdlog::debug("Выгружено: документ: {}", mName);
     }
 
-    pugi::xml_node Document::makeNode(pugi::xml_node md) {
-        auto output = md.append_child("Document");
-        output.append_attribute("uuid").set_value(ids::getUUIDFor(getQualifiedName()));
-        return output;
+    void Document::generateConfigVersions(versions::Shard& shard) {
+        shard.add(getQualifiedName(), mVersion);
+        mProperties->addConfigVersionForAll(shard);
+        mTabulars->addConfigVersionForAll(shard);
+        for (const auto& form : mForms) {
+            shard.add(getQualifiedName() + ".Form." + form, "");
+        }
     }
 
-    void Document::generateConfigVersions(pugi::xml_node parent) {
-        xmltools::addConfigVersion(parent, getQualifiedName(), mVersion);
-        mProperties->addConfigVersionForAll(parent);
-        mTabulars->addConfigVersionForAll(parent);
+    void Document::collectReferences(vector<validation::Reference>& out) {
+        mProperties->collectReferencesForAll(out);
+        mTabulars->collectReferencesForAll(out);
     }
 
     void Document::setPropertyList(shared_ptr<PropertyList> properties) {
@@ -367,6 +655,10 @@ namespace objects {
     void Document::setTabularsList(shared_ptr<TabularsList> tabulars) {
         mTabulars = tabulars;
     }
+
+    void Document::setForms(vector<string> forms) {
+        mForms = move(forms);
+    }
     //==============================//
 
     //==========Справочник==========//
@@ -377,52 +669,44 @@ namespace objects {
         string version,
         shared_ptr<Configuration> parent
     )
-        : ObjectNode{name, synonym, comment, version, parent } {}
+        : ObjectNode{name, move(synonym), comment, version, parent } {}
 
     string Catalog::getQualifiedName() {
         return "Catalog." + mName;
     }
 
     void Catalog::exportToFiles(fs::path exportRoot) {
-        auto doc    = ObjectNode::createDocument();
-        auto obj    = this->makeNode(doc.child("MetaDataObject"));
-        
-        auto internalInfo   = obj.append_child("InternalInfo");
-        auto properties     = obj.append_child("Properties");
-        auto children       = obj.append_child("ChildObjects");
-
-        // Внутренняя информация
-        xmltools::addGeneratedType(internalInfo, "CatalogObject."+mName, "Object");
-        xmltools::addGeneratedType(internalInfo, "CatalogRef."+mName, "Ref");
-        xmltools::addGeneratedType(internalInfo, "CatalogSelection."+mName, "Selection");
-        xmltools::addGeneratedType(internalInfo, "CatalogList."+mName, "List");
-        xmltools::addGeneratedType(internalInfo, "CatalogManager."+mName, "Manager");
-
-        // Свойства
-        xmltools::addNameNode(properties, mName);
-        xmltools::addLocalisedString(properties.append_child("Synonym"), mSynonym);
-        xmltools::addCommentNode(properties, mComment);
-
-        // Реквизиты
-        mProperties->addNodesForAll(children);
+        trace::Span span("export", "Catalog", mName);
+        report::Timer timer(getQualifiedName(), &report::ObjectStats::exportSeconds);
+        memstats::DomMeter domMeter;
+        string text;
+        try {
+            renderObject(text, "Catalog", getQualifiedName(), mName, mSynonym, mComment, *mProperties, *mTabulars, mForms);
+        } catch (const runtime_error& e) {
+            throw runtime_error(getQualifiedName() + ": " + e.what());
+        }
 
-        // Табличные части
-        mTabulars->addNodesForAll(children);
+        report::update(getQualifiedName(), [&](report::ObjectStats& s) {
+            s.attributes = mProperties->size();
+            s.columns = mTabulars->columnCount();
+        });
 
-        doc.save_file((exportRoot / "Catalogs" / (mName + ".xml")).c_str());
-        spdlog::info("Выгружено: справочник: {}", mName);
+        saveText(text, exportRoot / "Catalogs" / (mName + ".xml"));
+        spdlog::debug("Выгружено: справочник: {}", mName);
     }
 
-    pugi::xml_node Catalog::makeNode(pugi::xml_node md) {
-        auto output = md.append_child("Catalog");
-        output.append_attribute("uuid").set_value(ids::getUUIDFor(getQualifiedName()));
-        return output;
+    void Catalog::generateConfigVersions(versions::Shard& shard) {
+        shard.add(getQualifiedName(), mVersion);
+        mProperties->addConfigVersionForAll(shard);
+        mTabulars->addConfigVersionForAll(shard);
+        for (const auto& form : mForms) {
+            shard.add(getQualifiedName() + ".Form." + form, "");
+        }
     }
 
-    void Catalog::generateConfigVersions(pugi::xml_node parent) {
-        xmltools::addConfigVersion(parent, getQualifiedName(), mVersion);
-        mProperties->addConfigVersionForAll(parent);
-        mTabulars->addConfigVersionForAll(parent);
+    void Catalog::collectReferences(vector<validation::Reference>& out) {
+        mProperties->collectReferencesForAll(out);
+        mTabulars->collectReferencesForAll(out);
     }
 
     void Catalog::setPropertyList(shared_ptr<PropertyList> properties) {
@@ -432,6 +716,10 @@ namespace objects {
     void Catalog::setTabularsList(shared_ptr<TabularsList> tabulars) {
         mTabulars = tabulars;
     }
+
+    void Catalog::setForms(vector<string> forms) {
+        mForms = move(forms);
+    }
     //==============================//
     
     //==========Перечисление==========//
@@ -494,7 +782,7 @@ namespace objects {
         string updatesAddress,
         string defaultLanguageName
     )
-        : ObjectNode{name, synonym, comment, version, nullptr }
+        : ObjectNode{name, move(synonym), comment, version, nullptr }
         , mLanguages{}
         , mCatalogs{}
         //~ , mDocuments{}
@@ -502,7 +790,8 @@ namespace objects {
         , mVendor{vendor}
         , mDevVersion{devVersion}
         , mUpdatesAddress{updatesAddress}
-        , mDefaultLanguageName{defaultLanguageName} {}
+        , mDefaultLanguageName{defaultLanguageName}
+        , mDefaultLanguageIndex{-1} {}
 
     string Configuration::getQualifiedName() {
         return "Configuration." + mName;
@@ -516,15 +805,59 @@ namespace objects {
         }
     }
     
+    void Configuration::addStyleItem(shared_ptr<StyleItem> s) {
+        mStyleItems.push_back(s);
+    }
+
+    void Configuration::addLinkedObject(string kind, string name) {
+        mLinkedObjects.push_back({kind, name});
+    }
+
+    // Выгружает объект и возвращает его сводку
+    static ObjectSummary streamObject(ObjectNode& obj, fs::path exportRoot) {
+        ObjectSummary summary{obj.getName(), {}, {}};
+        obj.exportToFiles(exportRoot);
+        obj.generateConfigVersions(summary.versions);
+        obj.collectReferences(summary.references);
+        report::update(obj.getQualifiedName(), [&](report::ObjectStats& s) {
+            s.versionEntries = summary.versions.size();
+        });
+        return summary;
+    }
+
     void Configuration::addCatalog(shared_ptr<Catalog> c) {
-        mCatalogs.push_back(c);
+        if (mStreamingRoot.empty()) {
+            mCatalogs.push_back(c);
+        } else {
+            mStreamedCatalogs.push_back(streamObject(*c, mStreamingRoot));
+        }
     }
     
     void Configuration::addDocument(shared_ptr<Document> d) {
-        mDocuments.push_back(d);
+        if (mStreamingRoot.empty()) {
+            mDocuments.push_back(d);
+        } else {
+            mStreamedDocuments.push_back(streamObject(*d, mStreamingRoot));
+        }
+    }
+
+    void Configuration::addCatalogSummary(ObjectSummary summary) {
+        mStreamedCatalogs.push_back(move(summary));
+    }
+
+    void Configuration::addDocumentSummary(ObjectSummary summary) {
+        mStreamedDocuments.push_back(move(summary));
+    }
+
+    void Configuration::enableStreaming(fs::path exportRoot) {
+        mStreamingRoot = exportRoot;
+        fs::create_directory(exportRoot / "Catalogs");
+        fs::create_directory(exportRoot / "Documents");
     }
 
     void Configuration::exportToFiles(fs::path exportRoot) {
+        trace::Span span("export", "Configuration", mName);
+        memstats::DomMeter domMeter;
         // Документ конфигурации
         auto doc = ObjectNode::createDocument();
         auto obj = this->makeNode(doc.child("MetaDataObject"));
@@ -543,38 +876,55 @@ namespace objects {
         this->addContainedObject(internalInfo, "fb282519-d103-4dd3-bc12-cb271d631dfc");
 
         // Обработка Properties
-        // Основные:
-        xmltools::addNameNode(properties, mName);
-        xmltools::addLocalisedString(properties.append_child("Synonym"), mSynonym);
-        xmltools::addCommentNode(properties, mComment);
+        this->writeProperties(properties);
 
-        // Разработка:
-        properties.append_child("Vendor").text().set(mVendor);
-        properties.append_child("Version").text().set(mDevVersion);
-        properties.append_child("UpdateCatalogAddress").text().set(mUpdatesAddress);
-
-        // Основной язык
-        auto defLanguage = properties.append_child("DefaultLanguage");
-        defLanguage.text().set("Language." + mLanguages[mDefaultLanguageIndex]->getName());
+        // Ход выгрузки. В потоковом режиме справочники и документы уже
+        // выгружены при сборе
+        logging::Progress progress(
+            "Выгрузка",
+            mLanguages.size() + mStyleItems.size() + mCatalogs.size() + mDocuments.size()
+        );
 
         // Языки
         fs::create_directory(exportRoot / "Languages");
         for (auto lang : mLanguages) {
             lang->exportToFiles(exportRoot);
+            progress.step();
             children.append_child("Language").text().set(lang->getName());
         }
+        // Элементы стиля
+        if (!mStyleItems.empty()) {
+            fs::create_directory(exportRoot / "StyleItems");
+        }
+        for (auto item : mStyleItems) {
+            item->exportToFiles(exportRoot);
+            progress.step();
+            children.append_child("StyleItem").text().set(item->getName());
+        }
+        // Готовые объекты
+        for (const auto& linked : mLinkedObjects) {
+            children.append_child(linked.first.c_str()).text().set(linked.second);
+        }
         // Справочники
         fs::create_directory(exportRoot / "Catalogs");
         for (auto catalog : mCatalogs) {
             catalog->exportToFiles(exportRoot);
+            progress.step();
             children.append_child("Catalog").text().set(catalog->getName());
         }
-        // Справочники
+        for (const auto& summary : mStreamedCatalogs) {
+            children.append_child("Catalog").text().set(summary.name);
+        }
+        // Документы
         fs::create_directory(exportRoot / "Documents");
         for (auto doc : mDocuments) {
             doc->exportToFiles(exportRoot);
+            progress.step();
             children.append_child("Document").text().set(doc->getName());
         }
+        for (const auto& summary : mStreamedDocuments) {
+            children.append_child("Document").text().set(summary.name);
+        }
         // Перечисления
         //~ fs::create_directory(exportRoot / "Enums");
         //~ for (auto enumObj : mEnums) {
@@ -582,10 +932,26 @@ namespace objects {
             //~ children.append_child("Enum").text().set(enumObj.getName());
         //~ }
 
-        doc.save_file((exportRoot / "Configuration.xml").c_str());
+        saveDocument(doc, exportRoot / "Configuration.xml");
         spdlog::info("Выгружено: конфигурация: {}", mName);
     }
 
+    void Configuration::writeProperties(pugi::xml_node properties) {
+        // Основные:
+        xmltools::addNameNode(properties, mName);
+        xmltools::addLocalisedString(properties.append_child("Synonym"), mSynonym);
+        xmltools::addCommentNode(properties, mComment);
+
+        // Разработка:
+        properties.append_child("Vendor").text().set(mVendor);
+        properties.append_child("Version").text().set(mDevVersion);
+        properties.append_child("UpdateCatalogAddress").text().set(mUpdatesAddress);
+
+        // Основной язык
+        auto defLanguage = properties.append_child("DefaultLanguage");
+        defLanguage.text().set("Language." + mLanguages[mDefaultLanguageIndex]->getName());
+    }
+
     pugi::xml_node Configuration::makeNode(pugi::xml_node md) {
         auto output = md.append_child("Configuration");
         output.append_attribute("uuid").set_value(ids::getUUIDFor(getQualifiedName()));
@@ -595,16 +961,176 @@ namespace objects {
         return output;
     }
 
-    void Configuration::generateConfigVersions(pugi::xml_node parent) {
-        xmltools::addConfigVersion(parent, getQualifiedName(), mVersion);
+    void Configuration::generateConfigVersions(versions::Shard& shard) {
+        shard.add(getQualifiedName(), mVersion);
         for (auto obj : mLanguages)
-            obj->generateConfigVersions(parent);
+            obj->generateConfigVersions(shard);
+        for (auto obj : mStyleItems)
+            obj->generateConfigVersions(shard);
+        for (const auto& linked : mLinkedObjects)
+            shard.add(linked.first + "." + linked.second, "");
         for (auto obj : mCatalogs)
-            obj->generateConfigVersions(parent);
+            obj->generateConfigVersions(shard);
         for (auto obj : mDocuments)
-            obj->generateConfigVersions(parent);
+            obj->generateConfigVersions(shard);
         //~ for (auto obj : mEnums)
-            //~ obj.generateConfigVersions(parent, "Enum.");
+            //~ obj.generateConfigVersions(shard, "Enum.");
+    }
+
+    void Configuration::indexObjects(const function<void(const string&, const string&)>& add) {
+        for (auto obj : mLanguages)
+            add("Language", obj->getName());
+        for (auto obj : mStyleItems)
+            add("StyleItem", obj->getName());
+        for (const auto& linked : mLinkedObjects)
+            add(linked.first, linked.second);
+        for (auto obj : mCatalogs)
+            add("Catalog", obj->getName());
+        for (const auto& summary : mStreamedCatalogs)
+            add("Catalog", summary.name);
+        for (auto obj : mDocuments)
+            add("Document", obj->getName());
+        for (const auto& summary : mStreamedDocuments)
+            add("Document", summary.name);
+    }
+
+    void Configuration::indexExternal(validation::Index&, vector<validation::Issue>&) {
+        // У основной конфигурации внешних объектов нет
+    }
+
+    vector<validation::Issue> Configuration::validate() {
+        vector<validation::Issue> issues;
+
+        // Индекс объектов по виду и имени
+        validation::Index index;
+        auto addToIndex = [&](const string& kind, const string& name) {
+            if (!index.add(kind, name)) {
+                issues.push_back({kind + "." + name, "объект объявлен повторно"});
+            }
+        };
+        indexObjects(addToIndex);
+        indexExternal(index, issues);
+
+        // Объекты, ссылки которых нужно проверить. Для выгруженных в
+        // потоковом режиме ссылки уже собраны в сводке
+        struct Unit {
+            ObjectNode* object;
+            const vector<validation::Reference>* ready;
+        };
+        vector<Unit> units;
+        for (auto obj : mCatalogs)
+            units.push_back({obj.get(), nullptr});
+        for (const auto& summary : mStreamedCatalogs)
+            units.push_back({nullptr, &summary.references});
+        for (auto obj : mDocuments)
+            units.push_back({obj.get(), nullptr});
+        for (const auto& summary : mStreamedDocuments)
+            units.push_back({nullptr, &summary.references});
+
+        // Индекс только читается, поэтому объекты проверяются параллельно.
+        // Ошибки каждого объекта собираются отдельно и сливаются по порядку
+        vector<vector<validation::Issue>> unitIssues(units.size());
+        parallel::forEach(units.size(), [&](size_t i) {
+            trace::Span unitSpan("validate", "checkReferences");
+            if (units[i].ready != nullptr) {
+                validation::checkReferences(index, *units[i].ready, unitIssues[i]);
+                return;
+            }
+            vector<validation::Reference> references;
+            units[i].object->collectReferences(references);
+            validation::checkReferences(index, references, unitIssues[i]);
+        });
+
+        for (auto& found : unitIssues) {
+            issues.insert(issues.end(), found.begin(), found.end());
+        }
+        return issues;
+    }
+
+    void Configuration::exportConfigVersions(fs::path exportRoot) {
+        trace::Span span("versions", "exportConfigVersions");
+        // Объекты верхнего уровня в каноническом порядке. У самой
+        // конфигурации и у объектов, выгруженных в потоковом режиме,
+        // записи уже готовы, остальные формируются здесь
+        struct Unit {
+            ObjectNode* object;
+            const versions::Shard* ready;
+        };
+        versions::Shard own;
+        own.add(getQualifiedName(), mVersion);
+
+        vector<Unit> units;
+        units.push_back({nullptr, &own});
+        for (auto obj : mLanguages)
+            units.push_back({obj.get(), nullptr});
+        for (auto obj : mStyleItems)
+            units.push_back({obj.get(), nullptr});
+        versions::Shard linked;
+        for (const auto& object : mLinkedObjects)
+            linked.add(object.first + "." + object.second, "");
+        units.push_back({nullptr, &linked});
+        for (auto obj : mCatalogs)
+            units.push_back({obj.get(), nullptr});
+        for (const auto& summary : mStreamedCatalogs)
+            units.push_back({nullptr, &summary.versions});
+        for (auto obj : mDocuments)
+            units.push_back({obj.get(), nullptr});
+        for (const auto& summary : mStreamedDocuments)
+            units.push_back({nullptr, &summary.versions});
+
+        // Подряд идущие объекты без готовых записей делятся на отрезки,
+        // каждый отрезок - своя часть. Отрезков больше, чем потоков, чтобы
+        // крупные объекты не тормозили остальных
+        size_t pending = 0;
+        for (const auto& unit : units)
+            if (unit.object != nullptr) pending++;
+        size_t parts = (size_t)parallel::getThreadCount() * 4;
+        size_t chunkSize = max<size_t>(1, (pending + parts - 1) / parts);
+
+        // Отрезки [begin, end) в units и порядок вывода: номер отрезка
+        // либо готовая часть
+        vector<pair<size_t, size_t>> chunks;
+        vector<pair<size_t, const versions::Shard*>> order;
+        for (size_t i = 0; i < units.size();) {
+            if (units[i].ready != nullptr) {
+                order.push_back({0, units[i].ready});
+                i++;
+                continue;
+            }
+            size_t begin = i;
+            while (i < units.size() && units[i].ready == nullptr && i - begin < chunkSize)
+                i++;
+            order.push_back({chunks.size(), nullptr});
+            chunks.push_back({begin, i});
+        }
+
+        vector<versions::Shard> shards(chunks.size());
+        parallel::forEach(chunks.size(), [&](size_t chunk) {
+            trace::Span chunkSpan("versions", "shard");
+            for (size_t i = chunks[chunk].first; i < chunks[chunk].second; i++) {
+                size_t before = shards[chunk].size();
+                units[i].object->generateConfigVersions(shards[chunk]);
+                if (report::isEnabled()) {
+                    size_t entries = shards[chunk].size() - before;
+                    report::update(units[i].object->getQualifiedName(), [&](report::ObjectStats& s) {
+                        s.versionEntries = entries;
+                    });
+                }
+            }
+        });
+
+        vector<const versions::Shard*> output;
+        size_t total = 0;
+        for (const auto& entry : order) {
+            output.push_back(entry.second != nullptr ? entry.second : &shards[entry.first]);
+            total += output.back()->size();
+        }
+
+        {
+            trace::Span writeSpan("write", "writeConfigDumpInfo");
+            versions::writeConfigDumpInfo(exportRoot / "ConfigDumpInfo.xml", output);
+        }
+        spdlog::info("Выгружено: файл версий, записей: {}", total);
     }
 
     // Добавляет ContainedObject в <InternalInfo> конфигурации
@@ -613,5 +1139,80 @@ namespace objects {
         containedObject.append_child("xr:ClassId").text().set(uuid);
         containedObject.append_child("xr:ObjectId").text().set(ids::getUUID());
     }
+
+    shared_ptr<Language> Configuration::getDefaultLanguage() {
+        if (mDefaultLanguageIndex < 0) {
+            throw runtime_error(
+                getQualifiedName() + ": основной язык не найден: " + mDefaultLanguageName
+            );
+        }
+        return mLanguages[mDefaultLanguageIndex];
+    }
+
+    const string& Configuration::getDefaultLanguageName() const {
+        return mDefaultLanguageName;
+    }
+
+    const vector<shared_ptr<Language>>& Configuration::getLanguages() {
+        return mLanguages;
+    }
     //================================//
+
+    //==========Расширение конфигурации==========//
+    Extension::Extension(
+        string name,
+        lstring synonym,
+        string comment,
+        string version,
+        string vendor,
+        string devVersion,
+        string namePrefix,
+        string purpose,
+        shared_ptr<Configuration> base
+    )
+        : Configuration{
+            name,
+            move(synonym),
+            comment,
+            version,
+            vendor,
+            devVersion,
+            "",
+            base->getDefaultLanguage()->getName()
+        }
+        , mBase{base}
+        , mNamePrefix{namePrefix}
+        , mPurpose{purpose}
+    {
+        if (mPurpose != "Customization" && mPurpose != "AddOn" && mPurpose != "Patch") {
+            throw runtime_error(
+                getQualifiedName() + ": неизвестное назначение расширения: " + mPurpose
+            );
+        }
+    }
+
+    void Extension::writeProperties(pugi::xml_node properties) {
+        xmltools::addSubNode(properties, "ObjectBelonging", "Adopted");
+        xmltools::addNameNode(properties, mName);
+        xmltools::addLocalisedString(properties.append_child("Synonym"), mSynonym);
+        xmltools::addCommentNode(properties, mComment);
+        xmltools::addSubNode(properties, "ConfigurationExtensionPurpose", mPurpose);
+        xmltools::addSubNode(properties, "KeepMappingToExtendedConfigurationObjectsByIDs", "true");
+        xmltools::addSubNode(properties, "NamePrefix", mNamePrefix);
+        properties.append_child("Vendor").text().set(mVendor);
+        properties.append_child("Version").text().set(mDevVersion);
+        auto defLanguage = properties.append_child("DefaultLanguage");
+        defLanguage.text().set("Language." + mLanguages[mDefaultLanguageIndex]->getName());
+    }
+
+    void Extension::indexExternal(validation::Index& index, vector<validation::Issue>& issues) {
+        // Объекты основной конфигурации видны расширению. Заимствованные
+        // языки уже есть в индексе под тем же именем
+        mBase->indexObjects([&](const string& kind, const string& name) {
+            if (!index.add(kind, name) && kind != "Language") {
+                issues.push_back({kind + "." + name, "объект уже есть в основной конфигурации"});
+            }
+        });
+    }
+    //===========================================//
 }
\ No newline at end of file
@@ -1,15 +1,17 @@
 #pragma once
 
 // Классы бизнес-объектов конфигурации
+#include <functional>
 #include <unordered_map>
 #include <vector>
+#include "localised.hpp"
 #include "typing.hpp"
+#include "versions.hpp"
+#include "validation.hpp"
 #include <pugixml.hpp>
 #include <filesystem>
 #include <memory>
 
-// Словарь, где ключ - код языка, а значение - строка на этом языке
-using lstring = unordered_map<string, string>;
 using namespace std;
 
 namespace fs = std::filesystem;
@@ -28,15 +30,18 @@ namespace objects {
         PropertyList(shared_ptr<ObjectNode> parent);
         // Добавляет реквизит
         void add(shared_ptr<Property> p);
-        // Добавляет реквизиты в узел parent
-        void addNodesForAll(pugi::xml_node parent);
-        void addConfigVersionForAll(pugi::xml_node parent);
+        // Выводит реквизиты по шаблону, каждый с новой строки на уровне depth
+        void renderForAll(string& out, size_t depth);
+        void addConfigVersionForAll(versions::Shard& shard);
+        void collectReferencesForAll(vector<validation::Reference>& out);
+        // Количество реквизитов
+        size_t size();
         
         private:
         // Список реквизитов
         vector<shared_ptr<Property>> mProperties;
         // Владелец реквизитов
-        shared_ptr<ObjectNode> mParent;
+        weak_ptr<ObjectNode> mParent;
     };
 
     // Список табличных частей
@@ -45,15 +50,20 @@ namespace objects {
         TabularsList(shared_ptr<ObjectNode> parent);
         // Добавляет табличную часть
         void add(shared_ptr<TabularSection> ts);
-        // Добавляет реквизиты в узел parent
-        void addNodesForAll(pugi::xml_node parent);
-        void addConfigVersionForAll(pugi::xml_node parent);
+        // Выводит табличные части по шаблону, каждую с новой строки на уровне depth
+        void renderForAll(string& out, size_t depth);
+        void addConfigVersionForAll(versions::Shard& shard);
+        void collectReferencesForAll(vector<validation::Reference>& out);
+        // Количество табличных частей
+        size_t size();
+        // Количество колонок во всех табличных частях
+        size_t columnCount();
         
         private:
         // Список табличных частей
         vector<shared_ptr<TabularSection>> mTabulars;
         // Владелец табличных частей
-        shared_ptr<ObjectNode> mParent;
+        weak_ptr<ObjectNode> mParent;
     };
 
     // Узел конфигурации. Может хранить имя, синоним, комментарий
@@ -72,30 +82,36 @@ namespace objects {
         // реализовывать этот метод
         // exportRoot - путь к каталогу выгрузки
         virtual void exportToFiles(fs::path exportRoot) = 0;
-        // Создаёт запись в файле ConfigDumpInfo
-        virtual void generateConfigVersions(pugi::xml_node parent) = 0;
-        // Добавляет и возвращает узел к MetaDataObject
-        virtual pugi::xml_node makeNode(pugi::xml_node md) = 0;
+        // Добавляет записи для файла ConfigDumpInfo
+        virtual void generateConfigVersions(versions::Shard& shard) = 0;
         // Возвращает полный путь объекта
         virtual string getQualifiedName() = 0;
+        // Добавляет в out ссылки на другие объекты из типов объекта
+        // и его подчинённых
+        virtual void collectReferences(vector<validation::Reference>& out);
         // Возвращает имя объекта
         string getName();
         // Возвращает синоним объекта
-        lstring getSynonym();
+        const lstring& getSynonym();
         // Возвращает комментарий объекта
         string getComment();
         
         protected:
         // Создаёт файл объекта в выгрузке
         pugi::xml_document createDocument();
+        // Сохраняет файл объекта в выгрузке
+        void saveDocument(const pugi::xml_document& doc, const fs::path& path);
+        // Сохраняет готовый текст файла объекта в выгрузке
+        void saveText(const string& text, const fs::path& path);
         // Имя объекта
         string mName;
         // Синоним
         lstring mSynonym;
         // Комментарий
         string mComment;
-        // Родитель объекта
-        shared_ptr<ObjectNode> mParent;
+        // Родитель объекта. Слабая ссылка, чтобы объект освобождался
+        // вместе с владельцем
+        weak_ptr<ObjectNode> mParent;
         // Версия объекта
         string mVersion;
     };
@@ -112,9 +128,11 @@ namespace objects {
             shared_ptr<ObjectNode> parent
         );
         void exportToFiles(fs::path exportRoot) override;
-        pugi::xml_node makeNode(pugi::xml_node md) override;
+        // Выводит узел по шаблону. depth - уровень вложенности
+        void renderNode(string& out, size_t depth);
         string getQualifiedName() override;
-        void generateConfigVersions(pugi::xml_node parent) override;
+        void generateConfigVersions(versions::Shard& shard) override;
+        void collectReferences(vector<validation::Reference>& out) override;
 
         protected:
         shared_ptr<typing::Type> mType;
@@ -146,9 +164,11 @@ namespace objects {
             shared_ptr<typing::Type> type
         );
         void exportToFiles(fs::path exportRoot) override;
-        pugi::xml_node makeNode(pugi::xml_node md) override;
+        // Выводит узел по шаблону. depth - уровень вложенности
+        void renderNode(string& out, size_t depth);
         string getQualifiedName() override;
-        void generateConfigVersions(pugi::xml_node parent) override;
+        void generateConfigVersions(versions::Shard& shard) override;
+        void collectReferences(vector<validation::Reference>& out) override;
 
         protected:
         shared_ptr<typing::Type> mType;
@@ -166,11 +186,15 @@ namespace objects {
             string generatedTypePrefix
         );
         void exportToFiles(fs::path exportRoot) override;
-        pugi::xml_node makeNode(pugi::xml_node md) override;
+        // Выводит узел по шаблону. depth - уровень вложенности
+        void renderNode(string& out, size_t depth);
         string getQualifiedName() override;
-        void generateConfigVersions(pugi::xml_node parent) override;
+        void generateConfigVersions(versions::Shard& shard) override;
+        void collectReferences(vector<validation::Reference>& out) override;
 
         void addColumn(shared_ptr<TabularColumn> column);
+        // Количество колонок
+        size_t getColumnCount();
 
         protected:
         // Колонки ТЧ
@@ -191,14 +215,55 @@ namespace objects {
             string code
         );
         void exportToFiles(fs::path exportRoot) override;
-        pugi::xml_node makeNode(pugi::xml_node md) override;
         string getQualifiedName() override;
-        void generateConfigVersions(pugi::xml_node parent) override;
+        void generateConfigVersions(versions::Shard& shard) override;
+        string getCode();
 
         protected:
         string mCode;
     };
+
+    // Язык основной конфигурации, заимствованный расширением. Получает
+    // собственный идентификатор и ссылается на исходный язык
+    class AdoptedLanguage : public Language {
+        public:
+        AdoptedLanguage(shared_ptr<Language> original, shared_ptr<Configuration> extension);
+        void exportToFiles(fs::path exportRoot) override;
+        // Добавляет и возвращает узел к MetaDataObject
+        pugi::xml_node makeNode(pugi::xml_node md);
+        void generateConfigVersions(versions::Shard& shard) override;
+
+        protected:
+        // Идентификатор языка в расширении
+        string getUUID();
+        // Идентификатор исходного языка
+        string mExtendedObject;
+        // Имя расширения
+        string mExtensionName;
+    };
     
+    // Элемент стиля
+    class StyleItem : public ObjectNode {
+        public:
+        StyleItem(
+            string name,
+            string type,
+            vector<pair<string, string>> value,
+            shared_ptr<Configuration> parent
+        );
+        void exportToFiles(fs::path exportRoot) override;
+        // Добавляет и возвращает узел к MetaDataObject
+        pugi::xml_node makeNode(pugi::xml_node md);
+        string getQualifiedName() override;
+        void generateConfigVersions(versions::Shard& shard) override;
+
+        protected:
+        // Тип значения: Color или Font
+        string mType;
+        // Значение: у цвета - пара ("value", текст), у шрифта - атрибуты
+        vector<pair<string, string>> mValue;
+    };
+
     // Перечисление
     //~ class Enum : public ObjectNode {
         //~ public:
@@ -228,18 +293,22 @@ namespace objects {
             shared_ptr<Configuration> parent
         );
         void exportToFiles(fs::path exportRoot) override;
-        pugi::xml_node makeNode(pugi::xml_node md) override;
         string getQualifiedName() override;
-        void generateConfigVersions(pugi::xml_node parent) override;
+        void generateConfigVersions(versions::Shard& shard) override;
+        void collectReferences(vector<validation::Reference>& out) override;
 
         void setPropertyList(shared_ptr<PropertyList> properties);
         void setTabularsList(shared_ptr<TabularsList> tabulars);
+        // Задаёт имена форм объекта
+        void setForms(vector<string> forms);
 
         protected:
         // Список реквизитов
         shared_ptr<PropertyList> mProperties;
         // Список ТЧ
         shared_ptr<TabularsList> mTabulars;
+        // Имена форм
+        vector<string> mForms;
     };
     
     // Справочник
@@ -253,18 +322,33 @@ namespace objects {
             shared_ptr<Configuration> parent
         );
         void exportToFiles(fs::path exportRoot) override;
-        pugi::xml_node makeNode(pugi::xml_node md) override;
         string getQualifiedName() override;
-        void generateConfigVersions(pugi::xml_node parent) override;
+        void generateConfigVersions(versions::Shard& shard) override;
+        void collectReferences(vector<validation::Reference>& out) override;
 
         void setPropertyList(shared_ptr<PropertyList> properties);
         void setTabularsList(shared_ptr<TabularsList> tabulars);
+        // Задаёт имена форм объекта
+        void setForms(vector<string> forms);
 
         protected:
         // Список реквизитов
         shared_ptr<PropertyList> mProperties;
         // Список ТЧ
         shared_ptr<TabularsList> mTabulars;
+        // Имена форм
+        vector<string> mForms;
+    };
+
+    // Сводка об объекте, модель которого уже освобождена. Хранит только то,
+    // что нужно конфигурации для ChildObjects и ConfigDumpInfo
+    struct ObjectSummary {
+        // Имя объекта
+        string name;
+        // Записи объекта и его подчинённых для ConfigDumpInfo
+        versions::Shard versions;
+        // Ссылки объекта на другие объекты, для проверки
+        vector<validation::Reference> references;
     };
 
     // Конфигурация -- корневой узел
@@ -281,22 +365,64 @@ namespace objects {
             string defaultLanguageName
         );
         void exportToFiles(fs::path exportRoot) override;
-        pugi::xml_node makeNode(pugi::xml_node md) override;
+        // Добавляет и возвращает узел к MetaDataObject
+        pugi::xml_node makeNode(pugi::xml_node md);
         string getQualifiedName() override;
-        void generateConfigVersions(pugi::xml_node parent) override;
+        void generateConfigVersions(versions::Shard& shard) override;
 
         void addLanguage(shared_ptr<Language> l);
+        void addStyleItem(shared_ptr<StyleItem> s);
+        // Добавляет объект, файлы которого уже выгружены в обход модели
+        // (например, общий модуль пакета): вид и имя
+        void addLinkedObject(string kind, string name);
         void addCatalog(shared_ptr<Catalog> c);
         void addDocument(shared_ptr<Document> d);
+        // Добавляет справочник, от которого есть только сводка
+        void addCatalogSummary(ObjectSummary summary);
+        // Добавляет документ, от которого есть только сводка
+        void addDocumentSummary(ObjectSummary summary);
         void addContainedObject(pugi::xml_node parent, string uuid);
+        // Основной язык конфигурации
+        shared_ptr<Language> getDefaultLanguage();
+        // Имя основного языка из настроек проекта
+        const string& getDefaultLanguageName() const;
+        // Языки конфигурации
+        const vector<shared_ptr<Language>>& getLanguages();
+        // Перечисляет объекты верхнего уровня: вид и имя
+        void indexObjects(const function<void(const string&, const string&)>& add);
+        // Включает потоковый режим: справочники и документы выгружаются
+        // в exportRoot сразу при добавлении, от них остаётся только сводка
+        void enableStreaming(fs::path exportRoot);
+        // Проверяет конфигурацию: повторяющиеся объекты и ссылки на
+        // несуществующие объекты. Возвращает все найденные ошибки
+        vector<validation::Issue> validate();
+        // Формирует ConfigDumpInfo.xml в каталоге выгрузки. Записи объектов
+        // готовятся параллельно, порядок записей в файле не зависит от потоков
+        void exportConfigVersions(fs::path exportRoot);
 
         protected:
+        // Заполняет свойства в Configuration.xml
+        virtual void writeProperties(pugi::xml_node properties);
+        // Добавляет в индекс проверки объекты, внешние для этой конфигурации
+        virtual void indexExternal(validation::Index& index, vector<validation::Issue>& issues);
+
         // Список языков
         vector<shared_ptr<Language>> mLanguages;
+        // Элементы стиля
+        vector<shared_ptr<StyleItem>> mStyleItems;
+        // Готовые объекты: вид и имя
+        vector<pair<string, string>> mLinkedObjects;
         // Список справочников
         vector<shared_ptr<Catalog>> mCatalogs;
         // Список документов
         vector<shared_ptr<Document>> mDocuments;
+        // Справочники, от которых осталась только сводка (выгруженные в
+        // потоковом режиме или не выбранные для выгрузки)
+        vector<ObjectSummary> mStreamedCatalogs;
+        // Документы, от которых осталась только сводка
+        vector<ObjectSummary> mStreamedDocuments;
+        // Каталог выгрузки в потоковом режиме, пустой - режим выключен
+        fs::path mStreamingRoot;
         // Список перечисления
         //~ vector<Enum> mEnums;
         // Поставщик
@@ -310,4 +436,32 @@ namespace objects {
         // Индекс основного языка конфигурации в mLanguages
         int mDefaultLanguageIndex;
     };
+
+    // Расширение конфигурации. Основная конфигурация только читается,
+    // поэтому несколько расширений собираются параллельно
+    class Extension : public Configuration {
+        public:
+        Extension(
+            string name,
+            lstring synonym,
+            string comment,
+            string version,
+            string vendor,
+            string devVersion,
+            string namePrefix,
+            string purpose,
+            shared_ptr<Configuration> base
+        );
+
+        protected:
+        void writeProperties(pugi::xml_node properties) override;
+        void indexExternal(validation::Index& index, vector<validation::Issue>& issues) override;
+
+        // Основная конфигурация
+        shared_ptr<Configuration> mBase;
+        // Префикс имён объектов расширения
+        string mNamePrefix;
+        // Назначение: Customization, AddOn или Patch
+        string mPurpose;
+    };
 }
\ No newline at end of file
@@ -0,0 +1,406 @@
+#include "packages.hpp"
+#include "buildcache.hpp"
+#include "modules.hpp"
+#include "targets.hpp"
+#include "xmltools.hpp"
+#include "ids.hpp"
+#include "trace.hpp"
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pugixml.hpp>
+#include <spdlog/spdlog.h>
+
+namespace packages {
+
+    // Читает описание пакета id из каталога libDirectory
+    static Package readPackage(const fs::path& libDirectory, const string& id) {
+        fs::path directory = libDirectory / id;
+        fs::path descriptionPath = directory / "package.xml";
+        pugi::xml_document description;
+        if (!description.load_file(descriptionPath.c_str())) {
+            throw runtime_error("Не удалось загрузить файл пакета : " + descriptionPath.string());
+        }
+        pugi::xml_node root = description.child("package");
+        Package package{
+            root.child("id").text().get(),
+            root.child("version").text().get(),
+            directory,
+            {},
+            {},
+            {}
+        };
+        if (package.id != id) {
+            throw runtime_error(
+                descriptionPath.string() + ": имя пакета " + package.id
+                + " не совпадает с каталогом " + id
+            );
+        }
+        for (
+            pugi::xml_node dependency = root.child("dependencies").child("dependency");
+            dependency;
+            dependency = dependency.next_sibling("dependency")
+        ) {
+            package.dependencies.push_back(dependency.text().get());
+        }
+        for (
+            pugi::xml_node include = root.child("sources").child("include");
+            include;
+            include = include.next_sibling("include")
+        ) {
+            package.sources.push_back(directory / include.text().get());
+        }
+        for (
+            pugi::xml_node include = root.child("styles").child("include");
+            include;
+            include = include.next_sibling("include")
+        ) {
+            package.styles.push_back(directory / include.text().get());
+        }
+        return package;
+    }
+
+    vector<Package> resolve(const fs::path& libDirectory, const vector<string>& roots) {
+        vector<Package> output;
+        // Состояние обхода: 1 - пакет в стеке, 2 - пакет уже в output
+        unordered_map<string, int> state;
+        vector<string> stack;
+
+        function<void(const string&)> visit = [&](const string& id) {
+            int& s = state[id];
+            if (s == 2) {
+                return;
+            }
+            if (s == 1) {
+                string cycle;
+                for (const auto& item : stack) {
+                    cycle += item + " -> ";
+                }
+                throw runtime_error("Циклическая зависимость пакетов: " + cycle + id);
+            }
+            s = 1;
+            stack.push_back(id);
+            Package package = readPackage(libDirectory, id);
+            for (const auto& dependency : package.dependencies) {
+                visit(dependency);
+            }
+            stack.pop_back();
+            state[id] = 2;
+            output.push_back(move(package));
+        };
+
+        for (const auto& root : roots) {
+            visit(root);
+        }
+        return output;
+    }
+
+    fs::path getDefaultCacheDirectory() {
+        const char* xdg = getenv("XDG_CACHE_HOME");
+        if (xdg != nullptr && *xdg) {
+            return fs::path(xdg) / "spb" / "packages";
+        }
+        const char* home = getenv("HOME");
+        if (home != nullptr && *home) {
+            return fs::path(home) / ".cache" / "spb" / "packages";
+        }
+        return {};
+    }
+
+    //==========Артефакт==========//
+    // Файл артефакта: заголовок, таблица записей, данные записей.
+    // Смещения отсчитываются от начала файла, числа - в порядке байтов
+    // машины, собравшей артефакт
+    static const char magic[8] = {'S', 'P', 'B', 'P', 'K', 'G', '2', '\n'};
+
+    // Вид записи артефакта
+    enum class EntryKind : uint32_t {
+        // Файл выгрузки: имя - путь относительно каталога выгрузки
+        File = 1,
+        // Таблица стилей: имя - путь относительно каталога пакета. Артефакт
+        // общий для всех проектов, поэтому путь достраивается при подключении
+        Style = 2,
+        // Объект верхнего уровня: имя - "Вид.Имя", данных нет
+        Object = 3
+    };
+
+    struct EntryHeader {
+        uint32_t kind;
+        uint32_t reserved;
+        uint64_t nameOffset;
+        uint64_t nameSize;
+        uint64_t dataOffset;
+        uint64_t dataSize;
+    };
+
+    struct FileHeader {
+        char magic[8];
+        uint64_t count;
+    };
+
+    // Запись при сборке артефакта
+    struct Entry {
+        EntryKind kind;
+        string name;
+        string data;
+    };
+
+    static string buildArtifact(const vector<Entry>& entries) {
+        FileHeader header;
+        memcpy(header.magic, magic, sizeof(magic));
+        header.count = entries.size();
+
+        size_t offset = sizeof(FileHeader) + entries.size() * sizeof(EntryHeader);
+        vector<EntryHeader> table;
+        for (const auto& entry : entries) {
+            EntryHeader h{static_cast<uint32_t>(entry.kind), 0, offset, entry.name.size(), 0, entry.data.size()};
+            offset += entry.name.size();
+            h.dataOffset = offset;
+            offset += entry.data.size();
+            table.push_back(h);
+        }
+
+        string output;
+        output.reserve(offset);
+        output.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.append(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(EntryHeader));
+        for (const auto& entry : entries) {
+            output += entry.name;
+            output += entry.data;
+        }
+        return output;
+    }
+
+    // Артефакт, отображённый в память
+    class MappedFile {
+        public:
+        explicit MappedFile(const fs::path& path) {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED) {
+                    mData = static_cast<const char*>(data);
+                    mSize = st.st_size;
+                }
+            }
+            close(fd);
+        }
+        ~MappedFile() {
+            if (mData != nullptr) {
+                munmap(const_cast<char*>(mData), mSize);
+            }
+        }
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return mData; }
+        size_t size() const { return mSize; }
+
+        private:
+        const char* mData = nullptr;
+        size_t mSize = 0;
+    };
+
+    // Проверяет заголовок и границы записей. Повреждённый артефакт
+    // пересобирается
+    static bool isValidArtifact(const char* data, size_t size) {
+        if (data == nullptr || size < sizeof(FileHeader)) {
+            return false;
+        }
+        FileHeader header;
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, magic, sizeof(magic)) != 0) {
+            return false;
+        }
+        if (header.count > (size - sizeof(FileHeader)) / sizeof(EntryHeader)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < header.count; i++) {
+            EntryHeader h;
+            memcpy(&h, data + sizeof(FileHeader) + i * sizeof(EntryHeader), sizeof(h));
+            if (h.nameOffset > size || h.nameSize > size - h.nameOffset
+                || h.dataOffset > size || h.dataSize > size - h.dataOffset)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    //============================//
+
+    // Общий модуль пакета: файл объекта
+    static string renderCommonModule(const string& name) {
+        pugi::xml_document doc;
+        pugi::xml_node md = doc.append_child("MetaDataObject");
+        xmltools::addNamespaces(md);
+        pugi::xml_node obj = md.append_child("CommonModule");
+        obj.append_attribute("uuid").set_value(ids::getUUIDFor("CommonModule." + name).c_str());
+        pugi::xml_node properties = obj.append_child("Properties");
+        xmltools::addNameNode(properties, name);
+        properties.append_child("Synonym");
+        xmltools::addCommentNode(properties, "");
+        xmltools::addSubNode(properties, "Global", "false");
+        xmltools::addSubNode(properties, "ClientManagedApplication", "true");
+        xmltools::addSubNode(properties, "Server", "true");
+        xmltools::addSubNode(properties, "ExternalConnection", "false");
+        xmltools::addSubNode(properties, "ClientOrdinaryApplication", "false");
+        xmltools::addSubNode(properties, "ServerCall", "false");
+        xmltools::addSubNode(properties, "Privileged", "false");
+        xmltools::addSubNode(properties, "ReturnValuesReuse", "DontUse");
+
+        string text;
+        xmltools::serializeDocument(doc, text);
+        return text;
+    }
+
+    // Прочитанные файлы пакета
+    struct Contents {
+        string description;
+        vector<string> sources;
+        vector<string> styles;
+    };
+
+    // Компилирует пакет в записи артефакта
+    static vector<Entry> compile(const Package& package, const Contents& contents) {
+        trace::Span span("packages", "compilePackage", package.id);
+        vector<Entry> entries;
+        if (!package.sources.empty()) {
+            string module;
+            for (size_t i = 0; i < package.sources.size(); i++) {
+                modules::validate(contents.sources[i], package.sources[i].string());
+                module += contents.sources[i];
+                if (!module.empty() && module.back() != '\n') {
+                    module += '\n';
+                }
+            }
+            string base = "CommonModules/" + package.id;
+            entries.push_back({EntryKind::File, base + ".xml", renderCommonModule(package.id)});
+            entries.push_back({EntryKind::File, base + "/Ext/Module.bsl", module});
+            entries.push_back({EntryKind::Object, "CommonModule." + package.id, ""});
+        }
+        for (size_t i = 0; i < package.styles.size(); i++) {
+            entries.push_back({
+                EntryKind::Style,
+                package.styles[i].lexically_relative(package.directory).generic_string(),
+                contents.styles[i]
+            });
+        }
+        return entries;
+    }
+
+    // Имя файла артефакта: имя, версия и хэш содержимого пакета
+    static string getArtifactName(const Package& package, const Contents& contents) {
+        uint64_t hash = buildcache::hashContent(contents.description.data(), contents.description.size());
+        // Файлы артефакта записаны в версии формата выгрузки
+        const string& format = targets::getVersion();
+        hash ^= buildcache::hashContent(format.data(), format.size());
+        hash *= 1099511628211ull;
+        for (const auto* group : {&contents.sources, &contents.styles}) {
+            for (const auto& text : *group) {
+                hash ^= buildcache::hashContent(text.data(), text.size());
+                hash *= 1099511628211ull;
+            }
+        }
+        // Версия может содержать что угодно, в имени файла - только безопасное
+        string version = package.version.empty() ? "0" : package.version;
+        for (auto& c : version) {
+            unsigned char u = c;
+            if (!(isalnum(u) || c == '.' || c == '-' || c == '_' || u >= 0x80)) {
+                c = '_';
+            }
+        }
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+        return package.id + "-" + version + "-" + hex + ".spbpkg";
+    }
+
+    static void writeBytes(const char* data, size_t size, const fs::path& path) {
+        ofstream file(path, ios::binary | ios::trunc);
+        file.write(data, size);
+        if (!file) {
+            throw runtime_error("Не удалось записать файл: " + path.string());
+        }
+    }
+
+    // Подключает записи артефакта data к выгрузке
+    static void apply(
+        const char* data,
+        const Package& package,
+        const fs::path& exportRoot,
+        Linked& out)
+    {
+        FileHeader header;
+        memcpy(&header, data, sizeof(header));
+        for (uint64_t i = 0; i < header.count; i++) {
+            EntryHeader h;
+            memcpy(&h, data + sizeof(FileHeader) + i * sizeof(EntryHeader), sizeof(h));
+            string name(data + h.nameOffset, h.nameSize);
+            const char* entryData = data + h.dataOffset;
+
+            switch (static_cast<EntryKind>(h.kind)) {
+                case EntryKind::File: {
+                    fs::path path = exportRoot / name;
+                    fs::create_directories(path.parent_path());
+                    writeBytes(entryData, h.dataSize, path);
+                    break;
+                }
+                case EntryKind::Style:
+                    out.sheets.push_back({(package.directory / name).string(), string(entryData, h.dataSize)});
+                    break;
+                case EntryKind::Object: {
+                    size_t dot = name.find('.');
+                    out.objects.push_back({name.substr(0, dot), name.substr(dot + 1)});
+                    break;
+                }
+                default:
+                    throw runtime_error("Неизвестная запись в артефакте пакета: " + to_string(h.kind));
+            }
+        }
+    }
+
+    Linked link(const Package& package, const fs::path& cacheDirectory, const fs::path& exportRoot) {
+        trace::Span span("packages", "linkPackage", package.id);
+        Contents contents;
+        contents.description = xmltools::readFile(package.directory / "package.xml");
+        for (const auto& path : package.sources) {
+            contents.sources.push_back(xmltools::readFile(path));
+        }
+        for (const auto& path : package.styles) {
+            contents.styles.push_back(xmltools::readFile(path));
+        }
+
+        Linked output;
+        if (!cacheDirectory.empty()) {
+            fs::path artifactPath = cacheDirectory / getArtifactName(package, contents);
+            MappedFile mapped(artifactPath);
+            if (isValidArtifact(mapped.data(), mapped.size())) {
+                apply(mapped.data(), package, exportRoot, output);
+                output.cached = true;
+                spdlog::debug("Пакет {} из кэша: {}", package.id, artifactPath.string());
+                return output;
+            }
+            string artifact = buildArtifact(compile(package, contents));
+            buildcache::writeAtomically(artifact, artifactPath);
+            apply(artifact.data(), package, exportRoot, output);
+            return output;
+        }
+
+        string artifact = buildArtifact(compile(package, contents));
+        apply(artifact.data(), package, exportRoot, output);
+        return output;
+    }
+}
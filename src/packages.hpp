@@ -0,0 +1,65 @@
+#ifndef PACKAGES_H
+#define PACKAGES_H
+
+// Пакеты библиотек из каталога Lib. Пакет описывается Lib/<Имя>/package.xml:
+//     <package>
+//         <id>Underscore</id>
+//         <version>1.0</version>
+//         <dependencies><dependency>Другой</dependency></dependencies>
+//         <sources><include>source.super</include></sources>
+//         <styles><include>style.css</include></styles>
+//     </package>
+// Исходники пакета становятся общим модулем с именем пакета. Каждая версия
+// пакета компилируется один раз в артефакт в общем кэше и дальше
+// подключается к выгрузкам без разбора и повторной выгрузки
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+#include "styles.hpp"
+
+namespace fs = std::filesystem;
+using namespace std;
+
+namespace packages {
+
+    // Описание пакета
+    struct Package {
+        string id;
+        string version;
+        // Каталог пакета
+        fs::path directory;
+        // Имена пакетов, от которых зависит этот
+        vector<string> dependencies;
+        // Исходники общего модуля в порядке объявления
+        vector<fs::path> sources;
+        // Таблицы стилей
+        vector<fs::path> styles;
+    };
+
+    // Пакеты roots и все их зависимости из каталога libDirectory.
+    // Зависимость идёт раньше зависящего от неё пакета. Циклы и
+    // отсутствующие пакеты - исключение runtime_error
+    vector<Package> resolve(const fs::path& libDirectory, const vector<string>& roots);
+
+    // Каталог общего кэша пакетов по умолчанию: $XDG_CACHE_HOME/spb/packages
+    // или ~/.cache/spb/packages. Пустой путь, если домашний каталог неизвестен
+    fs::path getDefaultCacheDirectory();
+
+    // То, что пакет добавляет в конфигурацию
+    struct Linked {
+        // Объекты верхнего уровня: вид и имя
+        vector<pair<string, string>> objects;
+        // Таблицы стилей пакета, в каскаде идут раньше таблиц проекта
+        vector<styles::Sheet> sheets;
+        // Артефакт взят из кэша
+        bool cached = false;
+    };
+
+    // Подключает пакет к выгрузке exportRoot: файлы пакета копируются из
+    // артефакта, остальное возвращается. Артефакт берётся из cacheDirectory
+    // или компилируется и сохраняется туда. Пустой cacheDirectory - без кэша
+    Linked link(const Package& package, const fs::path& cacheDirectory, const fs::path& exportRoot);
+}
+
+#endif
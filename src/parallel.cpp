@@ -0,0 +1,166 @@
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+    static unsigned threadCount = 0;
+
+    void setThreadCount(unsigned count) {
+        threadCount = count;
+    }
+
+    unsigned getThreadCount() {
+        if (threadCount != 0) {
+            return threadCount;
+        }
+        return max(1u, thread::hardware_concurrency());
+    }
+
+    // Общий пул рабочих потоков процесса. Потоки выполняют задачи из общей
+    // очереди, поэтому вложенные и одновременные вызовы forEach делят одни
+    // и те же ядра
+    class Pool {
+        public:
+        explicit Pool(size_t workers) {
+            for (size_t i = 0; i < workers; i++) {
+                mThreads.emplace_back([this]() { run(); });
+            }
+        }
+
+        ~Pool() {
+            {
+                lock_guard<mutex> lock(mMutex);
+                mStopping = true;
+            }
+            mReady.notify_all();
+            for (auto& t : mThreads) {
+                t.join();
+            }
+        }
+
+        void post(function<void()> task) {
+            {
+                lock_guard<mutex> lock(mMutex);
+                mTasks.push_back(move(task));
+            }
+            mReady.notify_one();
+        }
+
+        private:
+        void run() {
+            while (true) {
+                function<void()> task;
+                {
+                    unique_lock<mutex> lock(mMutex);
+                    mReady.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+                    if (mTasks.empty()) {
+                        return;
+                    }
+                    task = move(mTasks.front());
+                    mTasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        vector<thread> mThreads;
+        deque<function<void()>> mTasks;
+        mutex mMutex;
+        condition_variable mReady;
+        bool mStopping = false;
+    };
+
+    // Пул создаётся при первом обращении: число потоков должно быть
+    // задано до первого вызова forEach. Вызывающий поток работает сам,
+    // поэтому в пуле на один поток меньше
+    static Pool& getPool() {
+        static Pool pool(getThreadCount() - 1);
+        return pool;
+    }
+
+    // Состояние одного вызова forEach. Помощники из пула держат его до
+    // своего завершения, даже если вызов уже вернулся
+    struct Batch {
+        Batch(size_t count, const function<void(size_t)>& fn)
+            : count{count}
+            , fn{fn} {}
+
+        void work() {
+            for (size_t i = next++; i < count; i = next++) {
+                try {
+                    fn(i);
+                } catch (...) {
+                    lock_guard<mutex> lock(stateMutex);
+                    if (!error) {
+                        error = current_exception();
+                    }
+                    // Остальные элементы не обрабатываем
+                    next = count;
+                }
+            }
+        }
+
+        size_t count;
+        // Действительна, пока вызов не закрыт (closed)
+        const function<void(size_t)>& fn;
+        atomic<size_t> next{0};
+        exception_ptr error;
+        mutex stateMutex;
+        condition_variable finished;
+        // Помощников в работе
+        size_t running = 0;
+        // Вызывающий поток закончил свою часть: новые помощники не начинают
+        bool closed = false;
+    };
+
+    void forEach(size_t count, const function<void(size_t)>& fn) {
+        size_t workers = min<size_t>(getThreadCount(), count);
+        if (workers <= 1) {
+            for (size_t i = 0; i < count; i++) {
+                fn(i);
+            }
+            return;
+        }
+
+        // Помощники подключаются, когда в пуле освобождается поток. Ждать
+        // свободного потока вызывающий не должен: вложенные вызовы иначе
+        // заблокировали бы друг друга
+        auto batch = make_shared<Batch>(count, fn);
+        for (size_t t = 1; t < workers; t++) {
+            getPool().post([batch]() {
+                {
+                    lock_guard<mutex> lock(batch->stateMutex);
+                    if (batch->closed) {
+                        return;
+                    }
+                    batch->running++;
+                }
+                batch->work();
+                lock_guard<mutex> lock(batch->stateMutex);
+                if (--batch->running == 0) {
+                    batch->finished.notify_all();
+                }
+            });
+        }
+
+        // Текущий поток тоже участвует в работе
+        batch->work();
+        {
+            unique_lock<mutex> lock(batch->stateMutex);
+            batch->closed = true;
+            batch->finished.wait(lock, [&]() { return batch->running == 0; });
+        }
+
+        if (batch->error) {
+            rethrow_exception(batch->error);
+        }
+    }
+}
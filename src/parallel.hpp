@@ -0,0 +1,26 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// Простейшие средства параллельной обработки
+#include <cstddef>
+#include <functional>
+
+using namespace std;
+
+namespace parallel {
+
+    // Устанавливает число рабочих потоков. 0 - по числу ядер. Действует
+    // до первого вызова forEach: потом пул уже создан
+    void setThreadCount(unsigned count);
+
+    // Возвращает число рабочих потоков
+    unsigned getThreadCount();
+
+    // Вызывает fn(i) для каждого i из [0, count) на рабочих потоках.
+    // Порядок вызовов не определён, возврат - после обработки всех элементов.
+    // Первое выброшенное исключение пробрасывается вызывающему. Все вызовы,
+    // в том числе вложенные и из разных потоков, делят один пул потоков
+    void forEach(size_t count, const function<void(size_t)>& fn);
+}
+
+#endif
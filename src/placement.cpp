@@ -0,0 +1,208 @@
+#include "placement.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <linux/fs.h>
+
+namespace placement {
+
+    // Размер буфера для сравнения и копирования
+    static const size_t bufferSize = 1 << 17;
+
+    // Дескриптор файла, закрываемый при выходе из области видимости
+    struct File {
+        int fd;
+        explicit File(int fd) : fd(fd) {}
+        ~File() {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+    };
+
+    static runtime_error systemError(const string& message, const fs::path& path) {
+        return runtime_error(message + ": " + path.string() + " (" + strerror(errno) + ")");
+    }
+
+    Mode parseMode(const string& value) {
+        if (value == "auto") {
+            return Mode::Auto;
+        }
+        if (value == "hardlink") {
+            return Mode::Hardlink;
+        }
+        if (value == "copy") {
+            return Mode::Copy;
+        }
+        throw runtime_error("Неизвестный способ размещения файлов: " + value);
+    }
+
+    const char* getOutcomeName(Outcome outcome) {
+        switch (outcome) {
+            case Outcome::Unchanged: return "unchanged";
+            case Outcome::Reflinked: return "reflink";
+            case Outcome::Linked:    return "hardlink";
+            case Outcome::Copied:    return "copy_file_range";
+            case Outcome::Buffered:  return "buffered";
+        }
+        return "";
+    }
+
+    // Читает из fd ровно size байт, если файл не короче
+    static bool readFull(int fd, char* data, size_t size) {
+        while (size > 0) {
+            ssize_t n = read(fd, data, size);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    static void writeFull(int fd, const char* data, size_t size, const fs::path& path) {
+        while (size > 0) {
+            ssize_t n = write(fd, data, size);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                throw systemError("Не удалось записать файл", path);
+            }
+            data += n;
+            size -= n;
+        }
+    }
+
+    // Совпадает ли содержимое target с source. Файлы разного размера
+    // не читаются
+    static bool sameContent(int source, const struct stat& sourceStat, const fs::path& target) {
+        struct stat targetStat;
+        if (stat(target.c_str(), &targetStat) != 0 || !S_ISREG(targetStat.st_mode)) {
+            return false;
+        }
+        // Тот же файл: жёсткая ссылка с прошлой сборки
+        if (targetStat.st_dev == sourceStat.st_dev && targetStat.st_ino == sourceStat.st_ino) {
+            return true;
+        }
+        if (targetStat.st_size != sourceStat.st_size) {
+            return false;
+        }
+        File other(open(target.c_str(), O_RDONLY | O_CLOEXEC));
+        if (other.fd < 0) {
+            return false;
+        }
+        vector<char> a(bufferSize);
+        vector<char> b(bufferSize);
+        off_t left = sourceStat.st_size;
+        while (left > 0) {
+            size_t chunk = static_cast<size_t>(min<off_t>(left, bufferSize));
+            if (!readFull(source, a.data(), chunk) || !readFull(other.fd, b.data(), chunk)) {
+                return false;
+            }
+            if (memcmp(a.data(), b.data(), chunk) != 0) {
+                return false;
+            }
+            left -= chunk;
+        }
+        return true;
+    }
+
+    // copy_file_range до конца файла. Возвращает false, если ядро или
+    // файловая система не поддерживают его, до того как что-то скопировано
+    static bool copyRange(int source, int target, off_t size, const fs::path& path) {
+        off_t done = 0;
+        while (done < size) {
+            ssize_t n = copy_file_range(source, nullptr, target, nullptr, size - done, 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                if (done == 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL
+                    || errno == EOPNOTSUPP || errno == EBADF))
+                {
+                    return false;
+                }
+                throw systemError("Не удалось скопировать файл", path);
+            }
+            if (n == 0) {
+                // Исходный файл укоротился во время копирования
+                break;
+            }
+            done += n;
+        }
+        return true;
+    }
+
+    static void copyBuffered(int source, int target, const fs::path& path) {
+        vector<char> buffer(bufferSize);
+        while (true) {
+            ssize_t n = read(source, buffer.data(), buffer.size());
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                throw systemError("Не удалось прочитать файл", path);
+            }
+            if (n == 0) {
+                return;
+            }
+            writeFull(target, buffer.data(), n, path);
+        }
+    }
+
+    Outcome placeFile(const fs::path& source, const fs::path& target, Mode mode) {
+        File input(open(source.c_str(), O_RDONLY | O_CLOEXEC));
+        if (input.fd < 0) {
+            throw systemError("Не удалось открыть файл", source);
+        }
+        struct stat sourceStat;
+        if (fstat(input.fd, &sourceStat) != 0) {
+            throw systemError("Не удалось прочитать файл", source);
+        }
+
+        if (sameContent(input.fd, sourceStat, target)) {
+            return Outcome::Unchanged;
+        }
+        if (lseek(input.fd, 0, SEEK_SET) != 0) {
+            throw systemError("Не удалось прочитать файл", source);
+        }
+
+        fs::create_directories(target.parent_path());
+        // Старый файл удаляется, а не перезаписывается: он может быть
+        // жёсткой ссылкой на исходный файл проекта
+        if (unlink(target.c_str()) != 0 && errno != ENOENT) {
+            throw systemError("Не удалось заменить файл", target);
+        }
+
+        if (mode == Mode::Hardlink && link(source.c_str(), target.c_str()) == 0) {
+            return Outcome::Linked;
+        }
+
+        File output(open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+        if (output.fd < 0) {
+            throw systemError("Не удалось создать файл", target);
+        }
+        if (mode != Mode::Copy) {
+            if (ioctl(output.fd, FICLONE, input.fd) == 0) {
+                return Outcome::Reflinked;
+            }
+            if (copyRange(input.fd, output.fd, sourceStat.st_size, target)) {
+                return Outcome::Copied;
+            }
+        }
+        copyBuffered(input.fd, output.fd, target);
+        return Outcome::Buffered;
+    }
+}
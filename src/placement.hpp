@@ -0,0 +1,48 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+// Размещение в выгрузке файлов, которые попадают туда без изменений
+// (модули, двоичные и текстовые ресурсы). Содержимое по возможности
+// копирует ядро, не поднимая его в память процесса
+#include <filesystem>
+#include <string>
+
+namespace fs = std::filesystem;
+using namespace std;
+
+namespace placement {
+
+    // Способ размещения
+    enum class Mode {
+        // Клонирование (reflink), затем copy_file_range, затем буфер
+        Auto,
+        // Жёсткая ссылка на исходный файл; если нельзя - как Auto.
+        // Правка такого файла в выгрузке меняет и исходный
+        Hardlink,
+        // Только копирование через буфер
+        Copy
+    };
+
+    // Чем закончилось размещение
+    enum class Outcome {
+        // Файл в выгрузке уже совпадает с исходным
+        Unchanged,
+        Reflinked,
+        Linked,
+        // Скопировано ядром через copy_file_range
+        Copied,
+        // Скопировано через буфер
+        Buffered
+    };
+
+    // Разбирает значение --link-mode: auto, hardlink, copy
+    Mode parseMode(const string& value);
+
+    const char* getOutcomeName(Outcome outcome);
+
+    // Размещает source по пути target, создавая каталоги. Если target уже
+    // совпадает с source по содержимому, он не перезаписывается
+    Outcome placeFile(const fs::path& source, const fs::path& target, Mode mode);
+}
+
+#endif
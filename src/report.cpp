@@ -0,0 +1,144 @@
+#include "report.hpp"
+#include "jsontools.hpp"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+namespace report {
+
+    static atomic<bool> enabled{false};
+    static mutex statsMutex;
+    // Статистика в порядке появления объектов
+    static vector<ObjectStats> stats;
+    // Индекс в stats по полному имени
+    static unordered_map<string, size_t> statsIndex;
+
+    // Возвращает статистику объекта, создавая при необходимости.
+    // Вызывается под statsMutex
+    static ObjectStats& find(const string& qualifiedName) {
+        auto it = statsIndex.find(qualifiedName);
+        if (it != statsIndex.end()) {
+            return stats[it->second];
+        }
+        statsIndex[qualifiedName] = stats.size();
+        stats.push_back(ObjectStats{});
+        stats.back().qualifiedName = qualifiedName;
+        return stats.back();
+    }
+
+    void enable() {
+        enabled = true;
+    }
+
+    bool isEnabled() {
+        return enabled.load(memory_order_relaxed);
+    }
+
+    void update(const string& qualifiedName, const function<void(ObjectStats&)>& fn) {
+        if (!isEnabled()) {
+            return;
+        }
+        lock_guard<mutex> lock(statsMutex);
+        fn(find(qualifiedName));
+    }
+
+    ObjectStats get(const string& qualifiedName) {
+        lock_guard<mutex> lock(statsMutex);
+        auto it = statsIndex.find(qualifiedName);
+        if (it == statsIndex.end()) {
+            return ObjectStats{qualifiedName};
+        }
+        return stats[it->second];
+    }
+
+    Timer::Timer(string qualifiedName, double ObjectStats::*field)
+        : mQualifiedName{move(qualifiedName)}
+        , mField{field}
+        , mActive{isEnabled()}
+    {
+        if (mActive) {
+            mStart = chrono::steady_clock::now();
+        }
+    }
+
+    Timer::~Timer() {
+        if (!mActive) {
+            return;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - mStart).count();
+        update(mQualifiedName, [&](ObjectStats& s) { s.*mField += seconds; });
+    }
+
+    // Выводит список полных имён объектов в JSON
+    static void writeNames(ofstream& out, const vector<const ObjectStats*>& list) {
+        out << "[";
+        for (size_t i = 0; i < list.size(); i++) {
+            out << (i == 0 ? "" : ", ") << jsontools::quote(list[i]->qualifiedName);
+        }
+        out << "]";
+    }
+
+    void write(fs::path path, size_t topN) {
+        lock_guard<mutex> lock(statsMutex);
+
+        ofstream out(path, ios::binary | ios::trunc);
+        if (!out) {
+            throw runtime_error("Не удалось открыть файл отчёта: " + path.string());
+        }
+
+        out << "{\n  \"objects\": [\n";
+        for (size_t i = 0; i < stats.size(); i++) {
+            const auto& s = stats[i];
+            out << "    {\"name\": " << jsontools::quote(s.qualifiedName)
+                << ", \"parse_seconds\": " << s.parseSeconds
+                << ", \"export_seconds\": " << s.exportSeconds
+                << ", \"bytes_written\": " << s.bytesWritten
+                << ", \"elements\": " << s.elements
+                << ", \"dom_bytes\": " << s.domBytes
+                << ", \"attributes\": " << s.attributes
+                << ", \"columns\": " << s.columns
+                << ", \"config_dump_info_entries\": " << s.versionEntries
+                << "}" << (i + 1 < stats.size() ? "," : "") << "\n";
+        }
+        out << "  ],\n";
+
+        // Самые дорогие объекты
+        vector<const ObjectStats*> byTime;
+        for (const auto& s : stats) {
+            byTime.push_back(&s);
+        }
+        vector<const ObjectStats*> bySize = byTime;
+
+        size_t count = min(topN, byTime.size());
+        partial_sort(byTime.begin(), byTime.begin() + count, byTime.end(),
+            [](const ObjectStats* a, const ObjectStats* b) {
+                return a->parseSeconds + a->exportSeconds > b->parseSeconds + b->exportSeconds;
+            });
+        partial_sort(bySize.begin(), bySize.begin() + count, bySize.end(),
+            [](const ObjectStats* a, const ObjectStats* b) {
+                return a->bytesWritten > b->bytesWritten;
+            });
+        byTime.resize(count);
+        bySize.resize(count);
+
+        out << "  \"top_by_time\": ";
+        writeNames(out, byTime);
+        out << ",\n  \"top_by_bytes\": ";
+        writeNames(out, bySize);
+        out << "\n}\n";
+
+        for (const auto s : byTime) {
+            spdlog::info(
+                "Дорогой объект: {}: {:.1f} мс, {} байт",
+                s->qualifiedName,
+                (s->parseSeconds + s->exportSeconds) * 1000,
+                s->bytesWritten
+            );
+        }
+    }
+}
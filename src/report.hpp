@@ -0,0 +1,72 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+// Отчёт о стоимости сборки по объектам: время, объём, размер модели
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+namespace report {
+
+    // Статистика одного объекта выгрузки
+    struct ObjectStats {
+        // Полное имя объекта (Catalog.Номенклатура)
+        string qualifiedName;
+        // Время разбора файла настроек и построения модели, секунды
+        double parseSeconds = 0;
+        // Время выгрузки в файлы, секунды
+        double exportSeconds = 0;
+        // Записано байт
+        uintmax_t bytesWritten = 0;
+        // Элементов в выгруженных документах
+        size_t elements = 0;
+        // Памяти под DOM выгружаемых документов, байт. Справочники,
+        // документы и языки выводятся из шаблонов без DOM, у них 0
+        uint64_t domBytes = 0;
+        // Реквизитов
+        size_t attributes = 0;
+        // Колонок табличных частей
+        size_t columns = 0;
+        // Записей в ConfigDumpInfo.xml
+        size_t versionEntries = 0;
+    };
+
+    // Включает сбор статистики. Без вызова update ничего не делает
+    void enable();
+
+    // Включён ли сбор статистики
+    bool isEnabled();
+
+    // Изменяет статистику объекта. Потокобезопасно
+    void update(const string& qualifiedName, const function<void(ObjectStats&)>& fn);
+
+    // Возвращает копию статистики объекта
+    ObjectStats get(const string& qualifiedName);
+
+    // Добавляет время жизни таймера к полю статистики объекта
+    class Timer {
+        public:
+        Timer(string qualifiedName, double ObjectStats::*field);
+        ~Timer();
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        private:
+        string mQualifiedName;
+        double ObjectStats::*mField;
+        bool mActive;
+        chrono::steady_clock::time_point mStart;
+    };
+
+    // Записывает отчёт в JSON: статистика всех объектов и topN самых
+    // дорогих по времени и по объёму. Краткую сводку выводит в лог
+    void write(fs::path path, size_t topN);
+}
+
+#endif
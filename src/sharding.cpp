@@ -0,0 +1,196 @@
+#include "sharding.hpp"
+#include "modules.hpp"
+#include "parallel.hpp"
+#include "targets.hpp"
+#include "trace.hpp"
+#include "versions.hpp"
+#include <atomic>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <pugixml.hpp>
+
+namespace sharding {
+
+    Spec parseSpec(const string& value) {
+        auto parseNumber = [&](const string& text) -> size_t {
+            if (text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != string::npos) {
+                throw runtime_error("Неверная часть сборки, ожидается i/N: " + value);
+            }
+            return stoul(text);
+        };
+        size_t slash = value.find('/');
+        if (slash == string::npos) {
+            throw runtime_error("Неверная часть сборки, ожидается i/N: " + value);
+        }
+        size_t index = parseNumber(value.substr(0, slash));
+        size_t count = parseNumber(value.substr(slash + 1));
+        if (count == 0 || index == 0 || index > count) {
+            throw runtime_error("Номер части вне 1.." + to_string(count) + ": " + value);
+        }
+        return {index - 1, count};
+    }
+
+    bool contains(const Spec& spec, size_t position) {
+        return position % spec.count == spec.index;
+    }
+
+    // Справочники и документы в ChildObjects файла Configuration.xml
+    static vector<string> readChildObjects(const fs::path& path) {
+        pugi::xml_document doc;
+        if (!doc.load_file(path.c_str())) {
+            throw runtime_error("Не удалось прочитать файл конфигурации: " + path.string());
+        }
+        vector<string> output;
+        pugi::xml_node children = doc.child("MetaDataObject")
+            .child("Configuration")
+            .child("ChildObjects");
+        for (pugi::xml_node child = children.first_child(); child; child = child.next_sibling()) {
+            string kind = child.name();
+            if (kind == "Catalog" || kind == "Document") {
+                output.push_back(kind + "." + child.text().get());
+            }
+        }
+        return output;
+    }
+
+    // Входит ли путь относительно корня выгрузки в каталоги справочников
+    // и документов
+    static bool isObjectPath(const fs::path& relative) {
+        const fs::path top = *relative.begin();
+        return top == modules::getTypeDirectory("Catalog")
+            || top == modules::getTypeDirectory("Document");
+    }
+
+    // Файлы объекта object (Catalog.Товары) в выгрузке root относительно
+    // корня: файл объекта и всё в каталоге объекта
+    static void addObjectFiles(const fs::path& root, const string& object, vector<fs::path>& out) {
+        size_t dot = object.find('.');
+        fs::path base = fs::path(modules::getTypeDirectory(object.substr(0, dot))) / object.substr(dot + 1);
+        fs::path file = base;
+        file += ".xml";
+        if (fs::is_regular_file(root / file)) {
+            out.push_back(file);
+        }
+        if (fs::is_directory(root / base)) {
+            for (const auto& entry : fs::recursive_directory_iterator(root / base)) {
+                if (entry.is_regular_file()) {
+                    out.push_back(fs::relative(entry.path(), root));
+                }
+            }
+        }
+    }
+
+    MergeResult merge(const vector<fs::path>& shards, const fs::path& outputPath, placement::Mode mode) {
+        trace::Span span("merge", "merge");
+        if (shards.empty()) {
+            throw runtime_error("Не указаны части для слияния");
+        }
+
+        // Файлы версий частей: кому принадлежит каждый объект
+        vector<versions::DumpInfo> dumps;
+        unordered_map<string, pair<size_t, const versions::Shard*>> owners;
+        for (const auto& shard : shards) {
+            dumps.push_back(versions::readConfigDumpInfo(shard / "ConfigDumpInfo.xml"));
+            if (dumps.back().version != dumps.front().version) {
+                throw runtime_error(
+                    "Части выгружены в разных версиях формата: " + shards.front().string()
+                    + " и " + shard.string()
+                );
+            }
+        }
+        for (size_t i = 0; i < dumps.size(); i++) {
+            for (const auto& entries : dumps[i].objects) {
+                size_t dot = entries.object.find('.');
+                string kind = entries.object.substr(0, dot);
+                if (kind != "Catalog" && kind != "Document") {
+                    continue;
+                }
+                if (!owners.insert({entries.object, {i, &entries.entries}}).second) {
+                    throw runtime_error(
+                        "Объект выгружен несколькими частями: " + entries.object
+                    );
+                }
+            }
+        }
+
+        // Порядок объектов - из конфигурации первой части
+        auto objects = readChildObjects(shards.front() / "Configuration.xml");
+        for (const auto& object : objects) {
+            if (owners.count(object) == 0) {
+                throw runtime_error("Объект не выгружен ни одной частью: " + object);
+            }
+        }
+        if (owners.size() != objects.size()) {
+            throw runtime_error("Части собраны из разных проектов: объекты не совпадают");
+        }
+
+        // Что откуда размещать: справочники и документы - из своих частей,
+        // остальное - из первой части, где файл есть
+        vector<pair<size_t, fs::path>> files;
+        vector<fs::path> directories;
+        unordered_set<string> taken;
+        for (size_t i = 0; i < shards.size(); i++) {
+            for (const auto& entry : fs::recursive_directory_iterator(shards[i])) {
+                fs::path relative = fs::relative(entry.path(), shards[i]);
+                if (relative == "ConfigDumpInfo.xml" || isObjectPath(relative)) {
+                    continue;
+                }
+                if (entry.is_directory()) {
+                    // Пустые каталоги тоже переносятся
+                    directories.push_back(move(relative));
+                } else if (entry.is_regular_file() && taken.insert(relative.string()).second) {
+                    files.push_back({i, relative});
+                }
+            }
+        }
+        for (const auto& object : objects) {
+            size_t owner = owners[object].first;
+            vector<fs::path> objectFiles;
+            addObjectFiles(shards[owner], object, objectFiles);
+            for (auto& file : objectFiles) {
+                files.push_back({owner, move(file)});
+            }
+        }
+
+        fs::create_directories(outputPath);
+        for (const auto& directory : directories) {
+            fs::create_directories(outputPath / directory);
+        }
+        atomic<size_t> placed{0};
+        parallel::forEach(files.size(), [&](size_t i) {
+            const auto& file = files[i];
+            if (placement::placeFile(shards[file.first] / file.second, outputPath / file.second, mode)
+                != placement::Outcome::Unchanged)
+            {
+                placed++;
+            }
+        });
+        // Каталоги видов объектов есть в выгрузке, даже если они пусты
+        fs::create_directories(outputPath / modules::getTypeDirectory("Catalog"));
+        fs::create_directories(outputPath / modules::getTypeDirectory("Document"));
+
+        // Файл версий: записи первой части до справочников (конфигурация,
+        // языки, стили, общие модули), затем объекты в порядке конфигурации
+        vector<const versions::Shard*> parts;
+        size_t total = 0;
+        for (const auto& entries : dumps.front().objects) {
+            if (owners.count(entries.object) == 0) {
+                parts.push_back(&entries.entries);
+                total += entries.entries.size();
+            }
+        }
+        for (const auto& object : objects) {
+            parts.push_back(owners[object].second);
+            total += owners[object].second->size();
+        }
+        targets::setVersion(dumps.front().version);
+        versions::writeConfigDumpInfo(outputPath / "ConfigDumpInfo.xml", parts);
+
+        MergeResult result;
+        result.objects = objects.size();
+        result.files = placed;
+        result.versions = total;
+        return result;
+    }
+}
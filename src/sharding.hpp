@@ -0,0 +1,53 @@
+#ifndef SHARDING_H
+#define SHARDING_H
+
+// Сборка по частям на нескольких машинах. Часть i из N (--shard i/N)
+// выгружает свою долю справочников и документов, для остальных в
+// конфигурацию попадают только сводки. Части затем сливаются (spb merge)
+// в полную выгрузку: объекты берутся из частей, которые их выгрузили,
+// Configuration.xml - из первой части, ConfigDumpInfo.xml собирается из
+// готовых записей частей
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "placement.hpp"
+
+namespace fs = std::filesystem;
+using namespace std;
+
+namespace sharding {
+
+    // Часть сборки
+    struct Spec {
+        // Номер части с нуля
+        size_t index = 0;
+        // Число частей, 1 - сборка целиком
+        size_t count = 1;
+    };
+
+    // Разбирает значение --shard: "i/N", части нумеруются с единицы
+    Spec parseSpec(const string& value);
+
+    // Входит ли в часть spec объект с номером position среди справочников
+    // и документов проекта (в порядке проекта). Раздача по кругу: части
+    // получают поровну объектов, разбиение зависит только от проекта
+    bool contains(const Spec& spec, size_t position);
+
+    // Что сделано при слиянии
+    struct MergeResult {
+        // Справочников и документов
+        size_t objects = 0;
+        // Размещено файлов
+        size_t files = 0;
+        // Записей в файле версий
+        size_t versions = 0;
+    };
+
+    // Сливает выгрузки частей shards в outputPath. Каждый справочник и
+    // документ конфигурации должен быть выгружен ровно одной частью.
+    // Файлы размещаются способом mode
+    MergeResult merge(const vector<fs::path>& shards, const fs::path& outputPath, placement::Mode mode);
+}
+
+#endif
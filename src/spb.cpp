@@ -7,7 +7,27 @@
 #include <vector>
 #include <stdexcept>
 #include "objects.hpp"
+#include "parallel.hpp"
+#include "graph.hpp"
+#include "validation.hpp"
+#include "trace.hpp"
+#include "report.hpp"
+#include "memstats.hpp"
+#include "logging.hpp"
+#include "modules.hpp"
+#include "forms.hpp"
+#include "styles.hpp"
+#include "packages.hpp"
+#include "translations.hpp"
+#include "buildcache.hpp"
+#include "placement.hpp"
+#include "includes.hpp"
+#include "sharding.hpp"
+#include "targets.hpp"
+#include <algorithm>
+#include <unordered_set>
 #include <spdlog/spdlog.h>
+#include <chrono>
 
 namespace fs = std::filesystem;
 using namespace std;
@@ -15,6 +35,7 @@ using namespace std;
 // Обработка языка
 void collectLanguage(
     pugi::xml_node config,
+    const fs::path& /* configPath */,
     shared_ptr<objects::Configuration> conf
 ) {
     string name     = config.child("id").text().get();
@@ -22,6 +43,17 @@ void collectLanguage(
     string comment  = config.child("comment").text().get();
     string code     = config.child("code").text().get();
     string version  = config.child("version").text().get();
+
+    // Язык не вошёл в выгрузку. Основной язык исключать нельзя
+    if (!xmltools::isLanguageIncluded(code)) {
+        if (name == conf->getDefaultLanguageName()) {
+            throw runtime_error(
+                "Основной язык " + name + " (" + code + ") исключён из выгрузки параметром --languages"
+            );
+        }
+        spdlog::debug("Язык пропущен: {}", name);
+        return;
+    }
     
     conf->addLanguage(make_shared<objects::Language>(
         name,
@@ -33,9 +65,19 @@ void collectLanguage(
     ));
 }
 
+// Имена форм объекта, найденных рядом с его файлом настроек
+vector<string> getFormNames(const fs::path& configPath, const string& kind) {
+    vector<string> names;
+    for (const auto& form : forms::discover(configPath, kind)) {
+        names.push_back(form.name);
+    }
+    return names;
+}
+
 // Обработка справочника
 void collectCatalog(
     pugi::xml_node config,
+    const fs::path& configPath,
     shared_ptr<objects::Configuration> conf
 ) {
     string name     = config.child("id").text().get();
@@ -109,12 +151,14 @@ void collectCatalog(
 
     catalog->setPropertyList(propertyList);
     catalog->setTabularsList(tabularsList);
+    catalog->setForms(getFormNames(configPath, "Catalog"));
     conf->addCatalog(catalog);
 }
 
 // Обработка справочника
 void collectDocument(
     pugi::xml_node config,
+    const fs::path& configPath,
     shared_ptr<objects::Configuration> conf
 ) {
     string name     = config.child("id").text().get();
@@ -188,6 +232,7 @@ void collectDocument(
 
     document->setPropertyList(propertyList);
     document->setTabularsList(tabularsList);
+    document->setForms(getFormNames(configPath, "Document"));
     conf->addDocument(document);
 }
 
@@ -217,67 +262,560 @@ void collectDocument(
     //~ return objects::Enum{name, synonym, comment, elements};
 //~ }
 
+// Возвращает пути к файлам с расширением extension, перечисленным в
+// <include> прямо, шаблоном или каталогом. Пустое extension - элементы
+// означают каталоги
+vector<fs::path> resolveIncludes(
+    pugi::xml_node includes,
+    fs::path projectPath,
+    fs::path typeDirectory,
+    const string& extension = ".xml")
+{
+    vector<string> patterns;
+    for (pugi::xml_node include = includes.child("include"); include; include = include.next_sibling("include")) {
+        patterns.push_back(include.text().get());
+    }
+    return includes::resolve(patterns, projectPath / typeDirectory, extension);
+}
+
+// Читает файл настроек объекта и возвращает его корневой узел
+pugi::xml_node loadObjectFile(
+    pugi::xml_document& objectConfig,
+    const fs::path& objectConfigPath,
+    const string& rootTagName,
+    const string& errorMessage)
+{
+    if (!objectConfig.load_file(objectConfigPath.c_str())) {
+        // Не удалось открыть файл настроек этого объекта
+        throw runtime_error(errorMessage + " : " + objectConfigPath.string());
+    }
+    return objectConfig.child(rootTagName);
+}
+
+// Записывает в отчёт время разбора объекта, начатого в start. В потоковом
+// режиме сборщик ещё и выгружает объект, это время уже учтено отдельно
+void reportParseTime(
+    const string& qualifiedName,
+    chrono::steady_clock::time_point start)
+{
+    if (!report::isEnabled()) {
+        return;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    report::update(qualifiedName, [&](report::ObjectStats& s) {
+        s.parseSeconds += seconds - s.exportSeconds;
+    });
+}
+
+// Собранный объект и его файл настроек
+struct CollectedObject {
+    string kind;
+    string name;
+    fs::path path;
+};
+
 void collectTypes(
     pugi::xml_node includes,
     fs::path projectPath,
     fs::path typeDirectory,
     string rootTagName,
     string errorMessage,
+    string kind,
     shared_ptr<objects::Configuration> conf,
-    void(*collector)(pugi::xml_node config, shared_ptr<objects::Configuration> conf))
+    void(*collector)(pugi::xml_node config, const fs::path& configPath, shared_ptr<objects::Configuration> conf),
+    vector<CollectedObject>& collected)
 {
-    for (pugi::xml_node include = includes.child("include"); include; include = include.next_sibling("include")) {
-        // Путь к настройкам объекта
-        fs::path objectConfigPath = projectPath / typeDirectory / include.text().get();
-
+    auto paths = resolveIncludes(includes, projectPath, typeDirectory);
+    logging::Progress progress("Сбор: " + kind, paths.size());
+    for (const auto& objectConfigPath : paths) {
         // Получить и прочитать настройки объекта
-        spdlog::info("Сбор информации: {}", objectConfigPath.string());
+        trace::Span span("collect", "collectTypes", objectConfigPath.string());
+        spdlog::debug("Сбор информации: {}", objectConfigPath.string());
+        auto start = chrono::steady_clock::now();
         pugi::xml_document objectConfig;
-        if (!objectConfig.load_file(objectConfigPath.c_str())) {
-            // Не удалось открыть файл настроек этого объекта
-            throw runtime_error(errorMessage + " : " + objectConfigPath.string());
-        }
-        pugi::xml_node objectInfo = objectConfig.child(rootTagName);
+        pugi::xml_node objectInfo = loadObjectFile(
+            objectConfig,
+            objectConfigPath,
+            rootTagName,
+            errorMessage
+        );
 
         // Обработать объект, добавить в конфигурацию
-        collector(objectInfo, conf);
+        collector(objectInfo, objectConfigPath, conf);
+        string name = objectInfo.child("id").text().get();
+        reportParseTime(kind + "." + name, start);
+        collected.push_back({kind, name, objectConfigPath});
+        progress.step();
     }
 }
 
-int main(int argc, char* argv[]) {
-    spdlog::set_level(spdlog::level::debug);
-    
-    // Парсинг аргументов
-    argparse::ArgumentParser program("superbuild", "0.0.1");
+// Объект, найденный при предварительном просмотре проекта
+struct ScannedObject {
+    // Путь к файлу настроек объекта
+    fs::path path;
+    // Имя объекта
+    string name;
+    // Ссылки из типов реквизитов и колонок
+    vector<validation::Reference> references;
+};
 
-    // Путь к корневому каталогу проекта
-    program.add_argument("-p", "--project");
+// Добавляет ссылку, если узел типа SUPER описывает ссылочный тип
+void scanTypeReference(
+    pugi::xml_node typeNode,
+    const string& owner,
+    vector<validation::Reference>& references)
+{
+    vector<string> tokens = xmltools::splitTypeId(typeNode.attribute("id").as_string());
+    if (tokens.size() == 3 && !validation::getTargetKind(tokens[1]).empty()) {
+        references.push_back({owner, tokens[1], tokens[2]});
+    }
+}
 
-    // Путь к выходному каталогу выгрузки
-    program.add_argument("-o", "--output");
+// Предварительный просмотр объектов: читает только имена и ссылки,
+// модель объектов не строится
+vector<ScannedObject> scanTypes(
+    pugi::xml_node includes,
+    fs::path projectPath,
+    fs::path typeDirectory,
+    string rootTagName,
+    string errorMessage,
+    string kind)
+{
+    vector<ScannedObject> output;
+    for (const auto& objectConfigPath : resolveIncludes(includes, projectPath, typeDirectory)) {
+        trace::Span span("collect", "scanTypes", objectConfigPath.string());
+        pugi::xml_document objectConfig;
+        pugi::xml_node config = loadObjectFile(
+            objectConfig,
+            objectConfigPath,
+            rootTagName,
+            errorMessage
+        );
 
-    try {
-        program.parse_args(argc, argv);
+        ScannedObject scanned{objectConfigPath, config.child("id").text().get(), {}};
+        string prefix = kind + "." + scanned.name;
+
+        for (
+            pugi::xml_node property = config.child("properties").child("property");
+            property;
+            property = property.next_sibling("property")
+        ) {
+            scanTypeReference(
+                property.child("type"),
+                prefix + ".Attribute." + property.child("id").text().get(),
+                scanned.references
+            );
+        }
+        for (
+            pugi::xml_node ts = config.child("tabular-sections").child("tabular-section");
+            ts;
+            ts = ts.next_sibling("tabular-section")
+        ) {
+            string tsPrefix = prefix + ".TabularSection." + ts.child("id").text().get();
+            for (
+                pugi::xml_node column = ts.child("columns").child("column");
+                column;
+                column = column.next_sibling("column")
+            ) {
+                scanTypeReference(
+                    column.child("type"),
+                    tsPrefix + ".Attribute." + column.child("id").text().get(),
+                    scanned.references
+                );
+            }
+        }
+
+        output.push_back(move(scanned));
     }
-    catch (const exception& err) {
-        spdlog::error(err.what());
-        cerr << program;
-        return 1;
+    return output;
+}
+
+// Собирает полностью только выбранные объекты. Для остальных в
+// конфигурацию попадает сводка без записей версий
+void collectSelected(
+    const vector<ScannedObject>& scanned,
+    string kind,
+    string rootTagName,
+    string errorMessage,
+    const unordered_set<string>& selected,
+    shared_ptr<objects::Configuration> conf,
+    void(*collector)(pugi::xml_node config, const fs::path& configPath, shared_ptr<objects::Configuration> conf),
+    void(objects::Configuration::*addSummary)(objects::ObjectSummary summary),
+    vector<CollectedObject>& collected)
+{
+    logging::Progress progress("Сбор: " + kind, scanned.size());
+    for (const auto& object : scanned) {
+        if (selected.count(kind + "." + object.name) == 0) {
+            ((*conf).*addSummary)({object.name, {}, object.references});
+            progress.step();
+            continue;
+        }
+
+        trace::Span span("collect", "collectSelected", object.path.string());
+        spdlog::debug("Сбор информации: {}", object.path.string());
+        auto start = chrono::steady_clock::now();
+        pugi::xml_document objectConfig;
+        pugi::xml_node objectInfo = loadObjectFile(
+            objectConfig,
+            object.path,
+            rootTagName,
+            errorMessage
+        );
+        collector(objectInfo, object.path, conf);
+        reportParseTime(kind + "." + object.name, start);
+        collected.push_back({kind, object.name, object.path});
+        progress.step();
     }
+}
 
-    srand(time(NULL));
+// Разбирает список через запятую ("Catalog.X, Document.Y" для --only,
+// "ru, kk" для --languages). Пробелы вокруг элементов отбрасываются,
+// пустые элементы пропускаются
+vector<string> splitCommaList(const string& value) {
+    vector<string> output;
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t end = value.find(',', start);
+        if (end == string::npos) {
+            end = value.size();
+        }
+        size_t first = value.find_first_not_of(" \t", start);
+        if (first != string::npos && first < end) {
+            size_t last = value.find_last_not_of(" \t", end - 1);
+            output.push_back(value.substr(first, last - first + 1));
+        }
+        start = end + 1;
+    }
+    return output;
+}
 
-    // Путь к корневому каталогу проекта, объект
-    fs::path projectPath = fs::path(program.get<string>("project"));
+// Кэш сборки этапа name в каталоге cacheDir, nullptr - кэш отключён
+unique_ptr<buildcache::Cache> openCache(const fs::path& cacheDir, const string& name) {
+    if (cacheDir.empty()) {
+        return nullptr;
+    }
+    return make_unique<buildcache::Cache>(cacheDir / (name + ".cache"));
+}
 
-    // Путь к каталогу выгрузки, объект
-    fs::path outputPath = fs::path(program.get<string>("output"));
+// Подключает к выгрузке пакеты из <include> узла packagesNode. Пакеты
+// независимы и подключаются параллельно. Возвращает таблицы стилей пакетов
+vector<styles::Sheet> linkPackages(
+    pugi::xml_node packagesNode,
+    const fs::path& libDirectory,
+    const fs::path& packageCacheDir,
+    const fs::path& outputPath,
+    shared_ptr<objects::Configuration> conf)
+{
+    vector<styles::Sheet> sheets;
+    vector<string> roots;
+    for (
+        pugi::xml_node include = packagesNode.child("include");
+        include;
+        include = include.next_sibling("include")
+    ) {
+        roots.push_back(include.text().get());
+    }
+    if (roots.empty()) {
+        return sheets;
+    }
+    auto resolved = packages::resolve(libDirectory, roots);
+    vector<packages::Linked> linked(resolved.size());
+    parallel::forEach(resolved.size(), [&](size_t i) {
+        linked[i] = packages::link(resolved[i], packageCacheDir, outputPath);
+    });
+    size_t cached = 0;
+    for (auto& result : linked) {
+        for (auto& object : result.objects) {
+            conf->addLinkedObject(move(object.first), move(object.second));
+        }
+        for (auto& sheet : result.sheets) {
+            sheets.push_back(move(sheet));
+        }
+        cached += result.cached ? 1 : 0;
+    }
+    spdlog::info("Пакетов: {}, из кэша: {}", resolved.size(), cached);
+    return sheets;
+}
+
+// Сводит таблицы стилей в элементы стиля конфигурации
+void addStyleItems(
+    vector<styles::Sheet> sheets,
+    const fs::path& cacheDir,
+    shared_ptr<objects::Configuration> conf)
+{
+    if (sheets.empty()) {
+        return;
+    }
+    auto index = styles::load(
+        sheets,
+        cacheDir.empty() ? fs::path() : cacheDir / "styles.index"
+    );
+    for (auto& entry : index) {
+        conf->addStyleItem(make_shared<objects::StyleItem>(
+            entry.name,
+            entry.type,
+            move(entry.value),
+            conf
+        ));
+    }
+    spdlog::info("Элементов стиля: {}", index.size());
+}
+
+// Формы собранных справочников и документов
+vector<forms::Job> discoverForms(const vector<CollectedObject>& collected) {
+    vector<forms::Job> formJobs;
+    for (const auto& object : collected) {
+        if (object.kind == "Catalog" || object.kind == "Document") {
+            for (auto& form : forms::discover(object.path, object.kind)) {
+                formJobs.push_back({object.kind, object.name, move(form)});
+            }
+        }
+    }
+    return formJobs;
+}
+
+// Компилирует формы в выгрузку outputPath
+void buildForms(
+    const vector<forms::Job>& formJobs,
+    const fs::path& outputPath,
+    const fs::path& cacheDir)
+{
+    if (formJobs.empty()) {
+        return;
+    }
+    auto cache = openCache(cacheDir, "forms");
+    auto result = forms::build(formJobs, outputPath, cache.get());
+    if (cache) {
+        cache->save();
+    }
+    spdlog::info("Формы: скомпилировано {}, без изменений {}", result.built, result.unchanged);
+}
+
+// Размещает в выгрузке outputPath модули объектов и форм
+void buildModules(
+    const vector<CollectedObject>& collected,
+    const vector<forms::Job>& formJobs,
+    const fs::path& outputPath,
+    const fs::path& cacheDir,
+    placement::Mode linkMode)
+{
+    vector<modules::Module> moduleList;
+    for (const auto& object : collected) {
+        if (object.kind == "Catalog" || object.kind == "Document") {
+            modules::discover(object.path, object.kind, object.name, outputPath, moduleList);
+        }
+    }
+    for (const auto& job : formJobs) {
+        if (!job.form.module.empty()) {
+            moduleList.push_back({
+                job.form.module,
+                forms::getFormDirectory(outputPath, job) / "Ext" / "Form" / "Module.bsl"
+            });
+        }
+    }
+    if (moduleList.empty()) {
+        return;
+    }
+    auto cache = openCache(cacheDir, "modules");
+    auto result = modules::build(
+        moduleList,
+        cache.get(),
+        linkMode
+    );
+    if (cache) {
+        cache->save();
+    }
+    spdlog::info("Модули: записано {}, без изменений {}", result.built, result.unchanged);
+}
+
+// Загружает переводы из файлов .po каталога directory/Strings по порядку
+// имён. Возвращает nullptr, если файлов переводов нет
+unique_ptr<translations::Table> loadTranslations(
+    const fs::path& directory,
+    shared_ptr<objects::Configuration> conf,
+    const translations::Table* fallback)
+{
+    fs::path stringsDirectory = directory / "Strings";
+    vector<fs::path> files;
+    if (fs::is_directory(stringsDirectory)) {
+        for (const auto& entry : fs::directory_iterator(stringsDirectory)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".po") {
+                files.push_back(entry.path());
+            }
+        }
+    }
+    if (files.empty()) {
+        return nullptr;
+    }
+    sort(files.begin(), files.end());
+
+    vector<string> codes;
+    for (const auto& language : conf->getLanguages()) {
+        codes.push_back(language->getCode());
+    }
+    auto table = make_unique<translations::Table>(
+        conf->getDefaultLanguage()->getCode(),
+        codes,
+        fallback
+    );
+    for (const auto& file : files) {
+        table->load(file);
+    }
+    spdlog::info("Переводов: {}", table->size());
+    return table;
+}
+
+// Настройки сборки, общие для конфигурации и её расширений
+struct BuildSettings {
+    // Каталог кэша сборки, пустой - кэш отключён
+    fs::path cacheDir;
+    // Общий кэш пакетов, пустой - пакеты компилируются в памяти
+    fs::path packageCacheDir;
+    placement::Mode linkMode;
+    // Проверять ссылки между объектами
+    bool validate;
+    // Переводы основной конфигурации, nullptr - нет
+    const translations::Table* strings;
+};
+
+// Собирает расширение из каталога directory (файл extension.xml) в
+// outputRoot/<Имя>. Основная конфигурация base только читается, поэтому
+// расширения собираются параллельно
+void buildExtension(
+    const fs::path& directory,
+    shared_ptr<objects::Configuration> base,
+    const fs::path& outputRoot,
+    const BuildSettings& settings)
+{
+    trace::Span span("extension", "buildExtension", directory.string());
+    pugi::xml_document extensionDoc;
+    pugi::xml_node extension = loadObjectFile(
+        extensionDoc,
+        directory / "extension.xml",
+        "extension",
+        "Не удалось загрузить файл расширения"
+    );
+    string name = extension.child("id").text().get();
+    string purpose = extension.child("purpose").text().get();
+
+    auto ext = make_shared<objects::Extension>(
+        name,
+        xmltools::parseLocalisedString(extension.child("synonym")),
+        extension.child("comment").text().get(),
+        extension.child("version").text().get(),
+        extension.child("vendor").text().get(),
+        extension.child("dev-version").text().get(),
+        extension.child("name-prefix").text().get(),
+        purpose.empty() ? "Customization" : purpose,
+        base
+    );
+    for (const auto& language : base->getLanguages()) {
+        ext->addLanguage(make_shared<objects::AdoptedLanguage>(language, ext));
+    }
+
+    // Свои переводы расширения дополняют переводы основной конфигурации
+    auto strings = loadTranslations(directory, ext, settings.strings);
+    translations::Scope stringsScope(strings ? strings.get() : settings.strings);
+
+    fs::path outputPath = outputRoot / name;
+    fs::path cacheDir = settings.cacheDir.empty()
+        ? fs::path()
+        : settings.cacheDir / "extensions" / name;
+    fs::create_directories(outputPath);
+
+    auto sheets = linkPackages(
+        extension.child("packages"),
+        directory / "Lib",
+        settings.packageCacheDir,
+        outputPath,
+        ext
+    );
+    addStyleItems(move(sheets), cacheDir, ext);
+
+    vector<CollectedObject> collected;
+    collectTypes(
+        extension.child("catalogs"),
+        directory,
+        "Catalogs",
+        "catalog",
+        "Не удалось загрузить файл справочника",
+        "Catalog",
+        ext,
+        &collectCatalog,
+        collected
+    );
+    collectTypes(
+        extension.child("documents"),
+        directory,
+        "Documents",
+        "document",
+        "Не удалось загрузить файл документа",
+        "Document",
+        ext,
+        &collectDocument,
+        collected
+    );
+
+    if (settings.validate) {
+        auto issues = ext->validate();
+        for (const auto& issue : issues) {
+            spdlog::error("{}: {}: {}", name, issue.where, issue.message);
+        }
+        if (!issues.empty()) {
+            throw runtime_error(
+                "Ошибок в расширении " + name + ": " + to_string(issues.size())
+            );
+        }
+    }
+
+    ext->exportToFiles(outputPath);
+    auto formJobs = discoverForms(collected);
+    buildForms(formJobs, outputPath, cacheDir);
+    buildModules(collected, formJobs, outputPath, cacheDir, settings.linkMode);
+    ext->exportConfigVersions(outputPath);
+    spdlog::info("Выгружено: расширение: {}", name);
+}
+
+// Параметры сборки одного проекта
+struct ProjectOptions {
+    // Корневой каталог проекта
+    fs::path projectPath;
+    // Каталог выгрузки основной цели
+    fs::path outputPath;
+    // Остальные цели: выводятся из основной выгрузки
+    vector<targets::Target> mirrors;
+    // Каталог выгрузок расширений, пустой - Extensions в каталоге выгрузки
+    fs::path extensionsOutput;
+    // Потоковый режим
+    bool streaming;
+    // Выгрузить только объекты only (--only) с замыканием closure
+    bool selective;
+    string only;
+    graph::Closure closure;
+    // Собираемая часть проекта, по умолчанию - весь проект
+    sharding::Spec shard;
+    // Коды выбранных языков, пустой - все языки проекта
+    vector<string> languageCodes;
+    // Переводы в settings подставляются при сборке
+    BuildSettings settings;
+};
+
+// Собирает проект в каталог выгрузки. При ошибке бросает исключение
+void buildProject(const ProjectOptions& options) {
+    const fs::path& projectPath = options.projectPath;
+    const fs::path& outputPath = options.outputPath;
+    const fs::path& cacheDir = options.settings.cacheDir;
 
     // Загрузка настроек XML проекта
     pugi::xml_document projectDoc;
-    if (!projectDoc.load_file((projectPath / "project.xml").c_str())) {
-        cerr << "Не удалось прочитать файл проекта" << endl;
-        return 1;
+    bool projectLoaded;
+    {
+        trace::Span span("phase", "loadProject");
+        projectLoaded = projectDoc.load_file((projectPath / "project.xml").c_str());
+        memstats::mark("loadProject");
+    }
+    if (!projectLoaded) {
+        throw runtime_error("Не удалось прочитать файл проекта");
     }
     pugi::xml_node project = projectDoc.child("project");
 
@@ -294,82 +832,826 @@ int main(int argc, char* argv[]) {
         project.child("default-language").text().get()
     );
 
+    // Выборочная выгрузка и выгрузка части всегда потоковые: так объекты
+    // в ChildObjects остаются в порядке проекта
+    bool partial = options.selective || options.shard.count > 1;
+    if (options.streaming || partial) {
+        conf->enableStreaming(outputPath);
+    }
+
+    // Собранные объекты в порядке проекта
+    vector<CollectedObject> collected;
+
     // Парсинг языков проекта
-    try {
+    {
+        trace::Span span("phase", "collectLanguages");
         collectTypes(
             project.child("languages"),
             projectPath,
             "Languages",
             "language-definition",
             "Не удалось загрузить файл языка",
+            "Language",
             conf,
-            &collectLanguage
+            &collectLanguage,
+            collected
         );
-    } catch (const runtime_error& e) {
-        cerr << e.what() << endl;
-        return 1;
+        // Все выбранные языки есть в проекте. Основной язык, исключённый
+        // --languages, отвергнут при сборе, здесь проверяется, что он объявлен
+        const auto& languages = conf->getLanguages();
+        for (const auto& code : options.languageCodes) {
+            bool found = any_of(languages.begin(), languages.end(), [&](const auto& language) {
+                return language->getCode() == code;
+            });
+            if (!found) {
+                throw runtime_error("Язык не найден в проекте: " + code);
+            }
+        }
+        bool hasDefault = any_of(languages.begin(), languages.end(), [&](const auto& language) {
+            return language->getName() == conf->getDefaultLanguageName();
+        });
+        if (!hasDefault) {
+            throw runtime_error("Основной язык не найден в проекте: " + conf->getDefaultLanguageName());
+        }
+        memstats::mark("collectLanguages");
     }
 
-    // Парсинг справочников проекта
-    try {
-        collectTypes(
+    // Переводы строк: подставляются при выгрузке до конца сборки
+    unique_ptr<translations::Table> strings;
+    {
+        trace::Span span("phase", "loadTranslations");
+        strings = loadTranslations(projectPath, conf, nullptr);
+        memstats::mark("loadTranslations");
+    }
+    translations::Scope stringsScope(strings.get());
+
+    // Пакеты библиотек: каждый подключается из артефакта в общем кэше
+    vector<styles::Sheet> packageSheets;
+    {
+        trace::Span span("phase", "packages");
+        packageSheets = linkPackages(
+            project.child("packages"),
+            projectPath / "Lib",
+            options.settings.packageCacheDir,
+            outputPath,
+            conf
+        );
+        memstats::mark("packages");
+    }
+
+    // Таблицы стилей: каскад сводится в элементы стиля. Таблицы пакетов
+    // идут первыми, проект может их перекрыть
+    {
+        trace::Span span("phase", "collectStyles");
+        auto sheets = styles::readSheets(
+            resolveIncludes(project.child("styles"), projectPath, "Styles", ".css")
+        );
+        sheets.insert(
+            sheets.begin(),
+            make_move_iterator(packageSheets.begin()),
+            make_move_iterator(packageSheets.end())
+        );
+        addStyleItems(move(sheets), cacheDir, conf);
+        memstats::mark("collectStyles");
+    }
+
+    if (partial) {
+        trace::Span span("phase", "collectSelected");
+        // Предварительный просмотр: имена и ссылки всех объектов
+        auto catalogs = scanTypes(
             project.child("catalogs"),
             projectPath,
             "Catalogs",
             "catalog",
             "Не удалось загрузить файл справочника",
-            conf,
-            &collectCatalog
+            "Catalog"
         );
-    } catch (const runtime_error& e) {
-        cerr << e.what() << endl;
-        return 1;
-    }
-
-    // Парсинг документов проекта
-    try {
-        collectTypes(
+        auto documents = scanTypes(
             project.child("documents"),
             projectPath,
             "Documents",
             "document",
             "Не удалось загрузить файл документа",
+            "Document"
+        );
+
+        unordered_set<string> selected;
+        if (options.selective) {
+            // Граф зависимостей
+            graph::DependencyGraph dependencies;
+            // Объекты, объявленные в проекте. Граф содержит и цели висячих ссылок
+            unordered_set<string> declared;
+            auto addToGraph = [&](const vector<ScannedObject>& scanned, const string& kind) {
+                for (const auto& object : scanned) {
+                    declared.insert(kind + "." + object.name);
+                    dependencies.addNode(kind + "." + object.name);
+                    for (const auto& ref : object.references) {
+                        dependencies.addEdge(
+                            kind + "." + object.name,
+                            validation::getTargetKind(ref.classId) + "." + ref.target
+                        );
+                    }
+                }
+            };
+            addToGraph(catalogs, "Catalog");
+            addToGraph(documents, "Document");
+
+            // Выбранные объекты и их замыкание
+            vector<string> roots = splitCommaList(options.only);
+            for (const auto& root : roots) {
+                if (declared.count(root) == 0) {
+                    throw runtime_error("Объект не найден в проекте: " + root);
+                }
+            }
+            selected = dependencies.closure(roots, options.closure);
+            for (auto it = selected.begin(); it != selected.end();) {
+                if (declared.count(*it) == 0) {
+                    it = selected.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            spdlog::info("Выбрано объектов для выгрузки: {}", selected.size());
+        } else {
+            // Доля части: справочники, затем документы в порядке проекта
+            size_t position = 0;
+            for (const auto& object : catalogs) {
+                if (sharding::contains(options.shard, position++)) {
+                    selected.insert("Catalog." + object.name);
+                }
+            }
+            for (const auto& object : documents) {
+                if (sharding::contains(options.shard, position++)) {
+                    selected.insert("Document." + object.name);
+                }
+            }
+            spdlog::info(
+                "Часть {} из {}: объектов для выгрузки: {}",
+                options.shard.index + 1,
+                options.shard.count,
+                selected.size()
+            );
+        }
+
+        collectSelected(
+            catalogs,
+            "Catalog",
+            "catalog",
+            "Не удалось загрузить файл справочника",
+            selected,
+            conf,
+            &collectCatalog,
+            &objects::Configuration::addCatalogSummary,
+            collected
+        );
+        collectSelected(
+            documents,
+            "Document",
+            "document",
+            "Не удалось загрузить файл документа",
+            selected,
             conf,
-            &collectDocument
+            &collectDocument,
+            &objects::Configuration::addDocumentSummary,
+            collected
         );
-    } catch (const runtime_error& e) {
-        cerr << e.what() << endl;
-        return 1;
+        memstats::mark("collectSelected");
+    } else {
+        // Парсинг справочников проекта
+        {
+            trace::Span span("phase", "collectCatalogs");
+            collectTypes(
+                project.child("catalogs"),
+                projectPath,
+                "Catalogs",
+                "catalog",
+                "Не удалось загрузить файл справочника",
+                "Catalog",
+                conf,
+                &collectCatalog,
+                collected
+            );
+            memstats::mark("collectCatalogs");
+        }
+
+        // Парсинг документов проекта
+        {
+            trace::Span span("phase", "collectDocuments");
+            collectTypes(
+                project.child("documents"),
+                projectPath,
+                "Documents",
+                "document",
+                "Не удалось загрузить файл документа",
+                "Document",
+                conf,
+                &collectDocument,
+                collected
+            );
+            memstats::mark("collectDocuments");
+        }
     }
     
     //~ // Парсинг перечислений проекта
     //~ vector<objects::Enum> enums;
-    //~ try {
-        //~ enums = collectTypes(
-            //~ project.child("enums"),
-            //~ projectPath,
-            //~ "Enums",
-            //~ "enum",
-            //~ "Не удалось загрузить файл перечисления",
-            //~ &collectEnum
-        //~ );
-    //~ } catch (const runtime_error& e) {
-        //~ cerr << e.what() << endl;
-        //~ return 1;
-    //~ }
+    //~ enums = collectTypes(
+        //~ project.child("enums"),
+        //~ projectPath,
+        //~ "Enums",
+        //~ "enum",
+        //~ "Не удалось загрузить файл перечисления",
+        //~ &collectEnum
+    //~ );
+
+    // Проверка ссылок между объектами
+    if (options.settings.validate) {
+        trace::Span span("phase", "validate");
+        auto validationStart = chrono::steady_clock::now();
+        auto issues = conf->validate();
+        auto validationTime = chrono::duration_cast<chrono::milliseconds>(
+            chrono::steady_clock::now() - validationStart
+        );
+        for (const auto& issue : issues) {
+            spdlog::error("{}: {}", issue.where, issue.message);
+        }
+        if (!issues.empty()) {
+            throw runtime_error("Ошибок в проекте: " + to_string(issues.size()));
+        }
+        spdlog::info("Проверка ссылок: ошибок нет ({} мс)", validationTime.count());
+        memstats::mark("validate");
+    }
+
+    {
+        trace::Span span("phase", "export");
+        conf->exportToFiles(outputPath);
+        memstats::mark("export");
+    }
+
+    // Справочники и документы с формами и модулями
+    auto formJobs = discoverForms(collected);
+
+    // Формы
+    {
+        trace::Span span("phase", "forms");
+        buildForms(formJobs, outputPath, cacheDir);
+        memstats::mark("forms");
+    }
+
+    // Модули объектов и форм
+    {
+        trace::Span span("phase", "modules");
+        buildModules(collected, formJobs, outputPath, cacheDir, options.settings.linkMode);
+        memstats::mark("modules");
+    }
 
     // Файл версий
-    pugi::xml_document versionsDoc;
-    auto configDumpInfo = versionsDoc.append_child("ConfigDumpInfo");
-    configDumpInfo.append_attribute("xmlns").set_value("http://v8.1c.ru/8.3/xcf/dumpinfo");
-    configDumpInfo.append_attribute("xmlns:xen").set_value("http://v8.1c.ru/8.3/xcf/enums");
-    configDumpInfo.append_attribute("xmlns:xs").set_value("http://www.w3.org/2001/XMLSchema");
-    configDumpInfo.append_attribute("xmlns:xsi").set_value("http://www.w3.org/2001/XMLSchema-instance");
-    configDumpInfo.append_attribute("format").set_value("Hierarchical");
-    configDumpInfo.append_attribute("version").set_value("2.18");
-    auto configVersions = configDumpInfo.append_child("ConfigVersions");
-
-    conf->exportToFiles(outputPath);
-    conf->generateConfigVersions(configVersions);
-    versionsDoc.save_file((outputPath / "ConfigDumpInfo.xml").c_str());
-}
\ No newline at end of file
+    {
+        trace::Span span("phase", "versions");
+        conf->exportConfigVersions(outputPath);
+        memstats::mark("versions");
+    }
+
+    // Расширения собираются параллельно против готовой модели конфигурации.
+    // При сборке по частям - только первой частью
+    if (options.shard.index == 0) {
+        trace::Span span("phase", "extensions");
+        auto extensions = resolveIncludes(project.child("extensions"), projectPath, "Extensions", "");
+        if (!extensions.empty()) {
+            fs::path extensionsOutput = options.extensionsOutput.empty()
+                ? outputPath / "Extensions"
+                : options.extensionsOutput;
+            BuildSettings settings = options.settings;
+            settings.strings = strings.get();
+            parallel::forEach(extensions.size(), [&](size_t i) {
+                buildExtension(extensions[i], conf, extensionsOutput, settings);
+            });
+            spdlog::info("Выгружено расширений: {}", extensions.size());
+        }
+        memstats::mark("extensions");
+    }
+
+    // Остальные цели из готовой выгрузки: модель не собирается заново
+    if (!options.mirrors.empty()) {
+        trace::Span span("phase", "targets");
+        for (const auto& target : options.mirrors) {
+            auto result = targets::mirror(outputPath, target, options.settings.linkMode);
+            spdlog::info(
+                "Выгружено: цель {} (версия {}): переписано {}, размещено {}, без изменений {}",
+                target.directory.string(),
+                target.version,
+                result.rewritten,
+                result.placed,
+                result.unchanged
+            );
+        }
+        memstats::mark("targets");
+    }
+}
+
+// Лежит ли нормализованный путь inner внутри каталога outer
+bool isWithin(const fs::path& inner, const fs::path& outer) {
+    auto o = outer.begin();
+    auto i = inner.begin();
+    for (; o != outer.end() && !o->empty(); ++o, ++i) {
+        if (i == inner.end() || *i != *o) {
+            return false;
+        }
+    }
+    return i != inner.end() && !i->empty();
+}
+
+// Каталог кэша сборки проекта: explicitDir, если задан, иначе .spb-cache в
+// каталоге проекта. Пустой - кэш отключён
+fs::path getCacheDirectory(const fs::path& projectPath, const string& explicitDir, bool noCache) {
+    if (noCache) {
+        return fs::path();
+    }
+    return explicitDir.empty() ? projectPath / ".spb-cache" : fs::path(explicitDir);
+}
+
+// Результат сборки проекта из пакета
+struct BatchResult {
+    // Код завершения: 0 - успех, 1 - ошибка
+    int exitCode;
+    string message;
+    chrono::milliseconds time;
+};
+
+// Читает файл пакетной сборки:
+//     <batch>
+//         <project>
+//             <path>Проекты/Склад</path>
+//             <output>Выгрузки/Склад</output>
+//             <cache-dir>...</cache-dir>                 необязательно
+//             <extensions-output>...</extensions-output> необязательно
+//         </project>
+//     </batch>
+// Относительные пути - от каталога файла. Остальные параметры берутся из
+// шаблона base
+vector<ProjectOptions> loadBatchManifest(
+    const fs::path& manifestPath,
+    const ProjectOptions& base,
+    bool noCache)
+{
+    pugi::xml_document manifestDoc;
+    pugi::xml_node batch = loadObjectFile(
+        manifestDoc,
+        manifestPath,
+        "batch",
+        "Не удалось загрузить файл пакетной сборки"
+    );
+    fs::path directory = manifestPath.parent_path();
+    auto resolve = [&](const string& path) {
+        return path.empty() ? fs::path() : directory / path;
+    };
+
+    vector<ProjectOptions> projects;
+    unordered_set<string> outputs;
+    for (
+        pugi::xml_node node = batch.child("project");
+        node;
+        node = node.next_sibling("project")
+    ) {
+        ProjectOptions options = base;
+        options.projectPath = resolve(node.child("path").text().get());
+        options.outputPath = resolve(node.child("output").text().get());
+        if (options.projectPath.empty() || options.outputPath.empty()) {
+            throw runtime_error(
+                "В файле пакетной сборки у проекта не указаны path или output: "
+                + manifestPath.string()
+            );
+        }
+        // Две сборки в один каталог испортили бы друг другу выгрузку
+        if (!outputs.insert(fs::absolute(options.outputPath).lexically_normal().string()).second) {
+            throw runtime_error("Каталог выгрузки указан дважды: " + options.outputPath.string());
+        }
+        string cacheDir = node.child("cache-dir").text().get();
+        options.settings.cacheDir = getCacheDirectory(
+            options.projectPath,
+            cacheDir.empty() ? "" : resolve(cacheDir).string(),
+            noCache
+        );
+        options.extensionsOutput = resolve(node.child("extensions-output").text().get());
+        projects.push_back(move(options));
+    }
+    if (projects.empty()) {
+        throw runtime_error("В файле пакетной сборки нет проектов: " + manifestPath.string());
+    }
+    return projects;
+}
+
+// Собирает проекты пакета одновременно на общем пуле потоков. Ошибка
+// одного проекта не прерывает остальные. Возвращает 0, если собраны все
+int buildBatch(const vector<ProjectOptions>& projects) {
+    vector<BatchResult> results(projects.size());
+    logging::Progress progress("Пакетная сборка", projects.size());
+    parallel::forEach(projects.size(), [&](size_t i) {
+        trace::Span span("batch", "buildProject", projects[i].projectPath.string());
+        auto start = chrono::steady_clock::now();
+        BatchResult& result = results[i];
+        try {
+            buildProject(projects[i]);
+            result.exitCode = 0;
+        } catch (const exception& e) {
+            result.exitCode = 1;
+            result.message = e.what();
+        }
+        result.time = chrono::duration_cast<chrono::milliseconds>(
+            chrono::steady_clock::now() - start
+        );
+        progress.step();
+    });
+
+    // Итоги в порядке файла пакета
+    size_t failed = 0;
+    for (size_t i = 0; i < projects.size(); i++) {
+        const auto& result = results[i];
+        const string project = projects[i].projectPath.string();
+        if (result.exitCode == 0) {
+            spdlog::info("{}: собран ({} мс)", project, result.time.count());
+        } else {
+            failed++;
+            cerr << project << ": " << result.message << endl;
+        }
+    }
+    spdlog::info("Собрано проектов: {} из {}", projects.size() - failed, projects.size());
+    return failed == 0 ? 0 : 1;
+}
+
+// Параметры процесса: потоки, размещение файлов, журнал и отчёты
+void addProcessArguments(argparse::ArgumentParser& parser) {
+    // Число рабочих потоков, 0 - по числу ядер
+    parser.add_argument("-j", "--jobs")
+        .default_value(0)
+        .scan<'i', int>();
+
+    // Как размещать в выгрузке файлы без изменений: auto (reflink или
+    // копирование ядром), hardlink (жёсткие ссылки) или copy (через буфер)
+    parser.add_argument("--link-mode")
+        .default_value(string("auto"));
+
+    // Уровень журнала: trace, debug, info, warning, error, critical, off.
+    // Строки по каждому объекту выводятся на уровне debug
+    parser.add_argument("--log-level")
+        .default_value(string("info"));
+
+    // Выводить только предупреждения и ошибки
+    parser.add_argument("-q", "--quiet")
+        .default_value(false)
+        .implicit_value(true);
+
+    // Записать трассировку этапов сборки в файл (формат Chrome trace-event)
+    parser.add_argument("--trace");
+
+    // Записать отчёт о стоимости сборки по объектам в файл JSON
+    parser.add_argument("--report");
+
+    // Записать замеры памяти по этапам сборки в файл JSON. Выделения
+    // operator new учитываются при сборке с -Dheap_accounting=true
+    parser.add_argument("--memory-report");
+
+    // Сколько самых дорогих объектов выводить в сводке отчёта
+    parser.add_argument("--report-top")
+        .default_value(10)
+        .scan<'i', int>();
+}
+
+// Параметры, общие для сборки проекта и пакетной сборки
+void addBuildArguments(argparse::ArgumentParser& parser) {
+    // Не проверять ссылки между объектами после сбора
+    parser.add_argument("--no-validate")
+        .default_value(false)
+        .implicit_value(true);
+
+    // Потоковый режим: справочники и документы выгружаются сразу после
+    // разбора, модель каждого объекта освобождается
+    parser.add_argument("--streaming")
+        .default_value(false)
+        .implicit_value(true);
+
+    // Выгружать только языки с этими кодами, через запятую: ru,kk. Строки
+    // на остальных языках не разбираются и не выводятся
+    parser.add_argument("--languages");
+
+    // Не использовать кэш сборки: стили, формы и модули собираются заново
+    parser.add_argument("--no-cache")
+        .default_value(false)
+        .implicit_value(true);
+
+    // Общий кэш скомпилированных пакетов Lib, по умолчанию
+    // ~/.cache/spb/packages. С --no-cache пакеты компилируются заново
+    parser.add_argument("--package-cache");
+}
+
+// Сборка проекта (program) или пакета (args - параметры команды batch).
+// Возвращает код завершения
+int runBuild(
+    const argparse::ArgumentParser& program,
+    const argparse::ArgumentParser& args,
+    bool batchMode,
+    placement::Mode linkMode)
+{
+    ProjectOptions options{};
+    options.settings.linkMode = linkMode;
+    options.settings.validate = !args.get<bool>("no-validate");
+    options.streaming = args.get<bool>("streaming");
+
+    // Языки выгрузки: фильтр действует с разбора синонима конфигурации и
+    // общий для всех проектов пакета
+    if (args.is_used("languages")) {
+        options.languageCodes = splitCommaList(args.get<string>("languages"));
+        if (options.languageCodes.empty()) {
+            cerr << "Не указаны языки выгрузки" << endl;
+            return 1;
+        }
+        xmltools::setLanguageFilter(options.languageCodes);
+    }
+
+    // Общий кэш пакетов, пустой - пакеты компилируются в памяти
+    bool noCache = args.get<bool>("no-cache");
+    if (!noCache) {
+        options.settings.packageCacheDir = args.is_used("package-cache")
+            ? fs::path(args.get<string>("package-cache"))
+            : packages::getDefaultCacheDirectory();
+    }
+
+    if (batchMode) {
+        try {
+            auto projects = loadBatchManifest(
+                fs::path(args.get<string>("manifest")),
+                options,
+                noCache
+            );
+            return buildBatch(projects);
+        } catch (const exception& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+    } else {
+        // Путь к корневому каталогу проекта, объект
+        options.projectPath = fs::path(program.get<string>("project"));
+
+        // Цели выгрузки: -o и --target, первая - основная
+        vector<targets::Target> targetList;
+        try {
+            if (program.is_used("output")) {
+                targetList.push_back({targets::defaultVersion, fs::path(program.get<string>("output"))});
+            }
+            if (program.is_used("target")) {
+                for (const auto& spec : program.get<vector<string>>("target")) {
+                    targetList.push_back(targets::parseTarget(spec));
+                }
+            }
+            if (targetList.empty()) {
+                throw runtime_error("Не указан каталог выгрузки (-o или --target)");
+            }
+            // Цели не пересекаются: цель внутри другой при выводе копировала
+            // бы саму себя
+            vector<fs::path> directories;
+            for (const auto& target : targetList) {
+                fs::path directory = fs::absolute(target.directory).lexically_normal();
+                if (!directory.has_filename()) {
+                    // out/ и out - один каталог
+                    directory = directory.parent_path();
+                }
+                for (size_t i = 0; i < directories.size(); i++) {
+                    if (directory == directories[i]) {
+                        throw runtime_error("Каталог выгрузки указан дважды: " + target.directory.string());
+                    }
+                    if (isWithin(directory, directories[i]) || isWithin(directories[i], directory)) {
+                        throw runtime_error(
+                            "Каталоги выгрузки вложены друг в друга: " + targetList[i].directory.string()
+                            + " и " + target.directory.string()
+                        );
+                    }
+                }
+                directories.push_back(directory);
+            }
+            if (targetList.size() > 1 && program.is_used("extensions-output")) {
+                // Расширения выводятся в цели вместе с конфигурацией
+                throw runtime_error("--extensions-output нельзя указать для нескольких целей");
+            }
+        } catch (const runtime_error& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        targets::setVersion(targetList.front().version);
+        options.outputPath = targetList.front().directory;
+        options.mirrors.assign(targetList.begin() + 1, targetList.end());
+
+        options.settings.cacheDir = getCacheDirectory(
+            options.projectPath,
+            program.is_used("cache-dir") ? program.get<string>("cache-dir") : "",
+            noCache
+        );
+        if (program.is_used("extensions-output")) {
+            options.extensionsOutput = fs::path(program.get<string>("extensions-output"));
+        }
+        options.selective = program.is_used("only");
+        if (options.selective) {
+            options.only = program.get<string>("only");
+        }
+
+        try {
+            if (program.is_used("closure")) {
+                if (!options.selective) {
+                    throw runtime_error("--closure указывается только вместе с --only");
+                }
+                options.closure = graph::parseClosure(program.get<string>("closure"));
+            }
+            if (program.is_used("shard")) {
+                if (options.selective) {
+                    throw runtime_error("--shard нельзя указать вместе с --only");
+                }
+                options.shard = sharding::parseSpec(program.get<string>("shard"));
+            }
+            buildProject(options);
+        } catch (const exception& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+}
+
+// Сливает выгрузки частей в одну. Возвращает код завершения
+int runMerge(const argparse::ArgumentParser& command, placement::Mode linkMode) {
+    try {
+        vector<fs::path> shards;
+        for (const auto& shard : command.get<vector<string>>("shards")) {
+            shards.push_back(shard);
+        }
+        if (!command.is_used("output")) {
+            throw runtime_error("Не указан каталог выгрузки (-o)");
+        }
+        auto result = sharding::merge(shards, fs::path(command.get<string>("output")), linkMode);
+        spdlog::info(
+            "Слито частей: {}, объектов: {}, размещено файлов: {}, записей версий: {}",
+            shards.size(),
+            result.objects,
+            result.files,
+            result.versions
+        );
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // Парсинг аргументов
+    argparse::ArgumentParser program("superbuild", "0.0.1");
+
+    // Путь к корневому каталогу проекта
+    program.add_argument("-p", "--project");
+
+    // Путь к выходному каталогу выгрузки
+    program.add_argument("-o", "--output");
+
+    // Дополнительная цель выгрузки "версия=каталог" или "каталог" (версия
+    // по умолчанию), можно указать несколько раз. Модель собирается один
+    // раз, первая цель выгружается полностью, остальные выводятся из неё.
+    // Без -o основной становится первая цель
+    program.add_argument("--target")
+        .append();
+
+    // Выгрузить только указанные объекты: "Catalog.X,Document.Y"
+    program.add_argument("--only");
+
+    // Замыкание зависимостей для --only: none, forward (и всё, на что
+    // ссылаются) или reverse (и всё, что ссылается на них)
+    program.add_argument("--closure")
+        .default_value(string("none"));
+
+    // Каталог кэша сборки, по умолчанию .spb-cache в каталоге проекта
+    program.add_argument("--cache-dir");
+
+    // Каталог выгрузок расширений, по умолчанию Extensions в каталоге
+    // выгрузки. Каждое расширение выгружается в подкаталог со своим именем
+    program.add_argument("--extensions-output");
+
+    // Собрать только часть i из N: "2/4". Справочники и документы
+    // раздаются частям по кругу, части сливаются командой merge
+    program.add_argument("--shard");
+
+    addBuildArguments(program);
+    addProcessArguments(program);
+
+    // Пакетная сборка: spb batch manifest.xml собирает в одном процессе
+    // все проекты файла на общем пуле потоков и с общими кэшами
+    argparse::ArgumentParser batchCommand("batch");
+    batchCommand.add_argument("manifest");
+    addBuildArguments(batchCommand);
+    addProcessArguments(batchCommand);
+    program.add_subparser(batchCommand);
+
+    // Слияние частей: spb merge -o каталог часть1 часть2 ...
+    argparse::ArgumentParser mergeCommand("merge");
+    mergeCommand.add_argument("-o", "--output");
+    mergeCommand.add_argument("shards")
+        .nargs(argparse::nargs_pattern::at_least_one);
+    addProcessArguments(mergeCommand);
+    program.add_subparser(mergeCommand);
+
+    try {
+        program.parse_args(argc, argv);
+    }
+    catch (const exception& err) {
+        spdlog::error(err.what());
+        cerr << program;
+        return 1;
+    }
+
+    // Общие параметры задаются после имени команды
+    bool batchMode = program.is_subcommand_used(batchCommand);
+    bool mergeMode = program.is_subcommand_used(mergeCommand);
+    const argparse::ArgumentParser& args = batchMode
+        ? batchCommand
+        : (mergeMode ? mergeCommand : program);
+
+    // Отчёты ведутся по именам объектов и этапам одной сборки: проекты
+    // пакета смешались бы в одном файле
+    if (batchMode && (args.is_used("report") || args.is_used("memory-report"))) {
+        cerr << "Параметры --report и --memory-report не поддерживаются в пакетной сборке" << endl;
+        return 1;
+    }
+
+    // Журнал асинхронный: очередь дописывается при любом выходе из main.
+    // Объявлен раньше остального, чтобы остановиться последним
+    struct LogShutdown {
+        ~LogShutdown() {
+            logging::shutdown();
+        }
+    } logShutdown;
+    try {
+        logging::setup(args.get<string>("log-level"), args.get<bool>("quiet"));
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    // Трассировка записывается при любом выходе из main, в том числе по ошибке
+    struct TraceWriter {
+        string path;
+        ~TraceWriter() {
+            if (path.empty()) {
+                return;
+            }
+            try {
+                trace::write(path);
+            } catch (const exception& e) {
+                cerr << e.what() << endl;
+            }
+        }
+    } traceWriter;
+    if (args.is_used("trace")) {
+        traceWriter.path = args.get<string>("trace");
+        trace::enable();
+    }
+    if (args.is_used("report")) {
+        report::enable();
+    }
+    if (args.is_used("memory-report")) {
+        memstats::enable();
+        memstats::mark("start");
+    }
+
+    parallel::setThreadCount(max(0, args.get<int>("jobs")));
+
+    placement::Mode linkMode;
+    try {
+        linkMode = placement::parseMode(args.get<string>("link-mode"));
+    } catch (const runtime_error& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    int exitCode = mergeMode
+        ? runMerge(mergeCommand, linkMode)
+        : runBuild(program, args, batchMode, linkMode);
+    if (exitCode != 0) {
+        return exitCode;
+    }
+
+    // Замеры памяти
+    if (args.is_used("memory-report")) {
+        try {
+            memstats::write(args.get<string>("memory-report"));
+        } catch (const runtime_error& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+    }
+
+    // Отчёт о стоимости объектов
+    if (args.is_used("report")) {
+        try {
+            report::write(args.get<string>("report"), max(0, args.get<int>("report-top")));
+        } catch (const runtime_error& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+    }
+    return exitCode;
+}
@@ -0,0 +1,458 @@
+#include "styles.hpp"
+#include "buildcache.hpp"
+#include "xmltools.hpp"
+#include "trace.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+
+namespace styles {
+
+    // Первая строка файла индекса, за ней хэш таблиц
+    static const char* header = "spb-styles 1";
+
+    // Объявление свойства, победившее в каскаде на данный момент
+    struct Declaration {
+        string value;
+        bool important;
+        // Файл и строка объявления, для сообщений об ошибках
+        string where;
+    };
+
+    // Каскад: элемент стиля -> свойство -> объявление
+    using Cascade = map<string, map<string, Declaration>>;
+
+    static const char* knownProperties[] = {
+        "color", "font-family", "font-size", "font-weight", "font-style", "text-decoration"
+    };
+
+    static bool isNameByte(unsigned char c) {
+        return (c >= 'a' && c <= 'z')
+            || (c >= 'A' && c <= 'Z')
+            || (c >= '0' && c <= '9')
+            || c == '_'
+            || c == '-'
+            || c >= 0x80;
+    }
+
+    // Разбор одной таблицы стилей
+    class Parser {
+        public:
+        Parser(const string& text, const string& sourceName, Cascade& cascade)
+            : mText(text)
+            , mSourceName(sourceName)
+            , mCascade(cascade) {}
+
+        void parse() {
+            while (true) {
+                skipSpace();
+                if (mPos >= mText.size()) {
+                    return;
+                }
+                if (mText[mPos] == '@') {
+                    fail("директивы @ не поддерживаются");
+                }
+                parseRule();
+            }
+        }
+
+        private:
+        [[noreturn]] void fail(const string& message) {
+            throw runtime_error(mSourceName + ":" + to_string(mLine) + ": " + message);
+        }
+
+        // Пропускает пробелы и комментарии
+        void skipSpace() {
+            while (mPos < mText.size()) {
+                char c = mText[mPos];
+                if (c == '\n') {
+                    mLine++;
+                    mPos++;
+                } else if (c == ' ' || c == '\t' || c == '\r') {
+                    mPos++;
+                } else if (mText.compare(mPos, 2, "/*") == 0) {
+                    size_t end = mText.find("*/", mPos + 2);
+                    if (end == string::npos) {
+                        fail("незакрытый комментарий");
+                    }
+                    for (size_t i = mPos; i < end; i++) {
+                        if (mText[i] == '\n') {
+                            mLine++;
+                        }
+                    }
+                    mPos = end + 2;
+                } else {
+                    return;
+                }
+            }
+        }
+
+        string readName() {
+            size_t start = mPos;
+            while (mPos < mText.size() && isNameByte(mText[mPos])) {
+                mPos++;
+            }
+            return mText.substr(start, mPos - start);
+        }
+
+        // Значение до ; или }. Пробелы схлопываются, кавычки сохраняются
+        string readValue() {
+            string value;
+            char quote = 0;
+            while (mPos < mText.size()) {
+                char c = mText[mPos];
+                if (quote == 0 && (c == ';' || c == '}')) {
+                    break;
+                }
+                if (c == '\n') {
+                    mLine++;
+                }
+                if (quote == 0 && (c == '"' || c == '\'')) {
+                    quote = c;
+                } else if (c == quote) {
+                    quote = 0;
+                }
+                if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                    if (!value.empty() && value.back() != ' ') {
+                        value += ' ';
+                    }
+                } else {
+                    value += c;
+                }
+                mPos++;
+            }
+            if (quote != 0) {
+                fail("незакрытая строка");
+            }
+            while (!value.empty() && value.back() == ' ') {
+                value.pop_back();
+            }
+            return value;
+        }
+
+        // Имя элемента стиля должно быть идентификатором 1С: начинаться с
+        // буквы или _ и не содержать -. Байты UTF-8 считаются буквами
+        void checkIdentifier(const string& name) {
+            unsigned char first = name[0];
+            bool letter = (first >= 'a' && first <= 'z')
+                || (first >= 'A' && first <= 'Z')
+                || first == '_'
+                || first >= 0x80;
+            if (!letter || name.find('-') != string::npos) {
+                fail("имя элемента стиля не является идентификатором: " + name);
+            }
+        }
+
+        void parseRule() {
+            // Имена элементов через запятую
+            vector<string> names;
+            while (true) {
+                skipSpace();
+                string name = readName();
+                if (name.empty()) {
+                    fail("ожидалось имя элемента стиля");
+                }
+                checkIdentifier(name);
+                names.push_back(name);
+                skipSpace();
+                if (mPos < mText.size() && mText[mPos] == ',') {
+                    mPos++;
+                    continue;
+                }
+                if (mPos < mText.size() && mText[mPos] == '{') {
+                    mPos++;
+                    break;
+                }
+                fail("ожидалась { или ,");
+            }
+
+            // Объявления
+            while (true) {
+                skipSpace();
+                if (mPos >= mText.size()) {
+                    fail("незакрытое правило");
+                }
+                if (mText[mPos] == '}') {
+                    mPos++;
+                    return;
+                }
+                if (mText[mPos] == ';') {
+                    mPos++;
+                    continue;
+                }
+
+                size_t line = mLine;
+                string property = readName();
+                for (auto& c : property) {
+                    if (c >= 'A' && c <= 'Z') {
+                        c += 32;
+                    }
+                }
+                bool known = false;
+                for (const char* p : knownProperties) {
+                    known = known || property == p;
+                }
+                if (!known) {
+                    fail("неизвестное свойство: " + property);
+                }
+                skipSpace();
+                if (mPos >= mText.size() || mText[mPos] != ':') {
+                    fail("ожидалось : после " + property);
+                }
+                mPos++;
+                skipSpace();
+
+                string value = readValue();
+                bool important = false;
+                const string mark = "!important";
+                if (value.size() >= mark.size()
+                    && value.compare(value.size() - mark.size(), mark.size(), mark) == 0)
+                {
+                    important = true;
+                    value.erase(value.size() - mark.size());
+                    while (!value.empty() && value.back() == ' ') {
+                        value.pop_back();
+                    }
+                }
+                if (value.empty()) {
+                    fail("пустое значение " + property);
+                }
+
+                // Позднее объявление перекрывает раннее, если раннее не !important
+                string where = mSourceName + ":" + to_string(line);
+                for (const auto& name : names) {
+                    auto& properties = mCascade[name];
+                    auto existing = properties.find(property);
+                    if (existing == properties.end() || important || !existing->second.important) {
+                        properties[property] = {value, important, where};
+                    }
+                }
+            }
+        }
+
+        const string& mText;
+        const string& mSourceName;
+        Cascade& mCascade;
+        size_t mPos = 0;
+        size_t mLine = 1;
+    };
+
+    [[noreturn]] static void failValue(const Declaration& d, const string& message) {
+        throw runtime_error(d.where + ": " + message + ": " + d.value);
+    }
+
+    // Цвет: #RGB, #RRGGBB или ссылка на цвет платформы (web:, win:, style:)
+    static string convertColor(const Declaration& d) {
+        const string& v = d.value;
+        for (const char* prefix : {"web:", "win:", "style:"}) {
+            if (v.compare(0, strlen(prefix), prefix) == 0) {
+                return v;
+            }
+        }
+        if ((v.size() != 4 && v.size() != 7) || v[0] != '#') {
+            failValue(d, "некорректный цвет");
+        }
+        string output = "#";
+        for (size_t i = 1; i < v.size(); i++) {
+            char c = v[i];
+            if (c >= 'a' && c <= 'f') {
+                c -= 32;
+            }
+            if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'F'))) {
+                failValue(d, "некорректный цвет");
+            }
+            output += c;
+            if (v.size() == 4) {
+                output += c;
+            }
+        }
+        return output;
+    }
+
+    // Атрибуты v8ui:Font из свойств font-* и text-decoration
+    static vector<pair<string, string>> convertFont(const map<string, Declaration>& properties) {
+        vector<pair<string, string>> output;
+        auto family = properties.find("font-family");
+        if (family != properties.end()) {
+            string face = family->second.value;
+            if (face.size() >= 2 && (face[0] == '"' || face[0] == '\'') && face.back() == face[0]) {
+                face = face.substr(1, face.size() - 2);
+            }
+            output.push_back({"faceName", face});
+        } else {
+            output.push_back({"ref", "sys:DefaultGUIFont"});
+        }
+
+        auto size = properties.find("font-size");
+        if (size != properties.end()) {
+            string height = size->second.value;
+            if (height.size() > 2 && height.compare(height.size() - 2, 2, "pt") == 0) {
+                height.erase(height.size() - 2);
+            }
+            char* end = nullptr;
+            double points = strtod(height.c_str(), &end);
+            if (height.empty() || *end != 0 || points <= 0) {
+                failValue(size->second, "некорректный размер шрифта");
+            }
+            output.push_back({"height", height});
+        }
+
+        auto flag = [&](const char* property, const char* attribute, vector<string> on, vector<string> off) {
+            auto it = properties.find(property);
+            if (it == properties.end()) {
+                return;
+            }
+            for (const auto& value : on) {
+                if (it->second.value == value) {
+                    output.push_back({attribute, "true"});
+                    return;
+                }
+            }
+            for (const auto& value : off) {
+                if (it->second.value == value) {
+                    output.push_back({attribute, "false"});
+                    return;
+                }
+            }
+            failValue(it->second, string("некорректное значение ") + property);
+        };
+        flag("font-weight", "bold", {"bold", "bolder", "700", "800", "900"}, {"normal", "lighter", "400"});
+        flag("font-style", "italic", {"italic", "oblique"}, {"normal"});
+
+        auto decoration = properties.find("text-decoration");
+        if (decoration != properties.end()) {
+            const string& value = decoration->second.value;
+            bool underline = value.find("underline") != string::npos;
+            bool strikeout = value.find("line-through") != string::npos;
+            if (!underline && !strikeout && value != "none") {
+                failValue(decoration->second, "некорректное значение text-decoration");
+            }
+            output.push_back({"underline", underline ? "true" : "false"});
+            output.push_back({"strikeout", strikeout ? "true" : "false"});
+        }
+
+        output.push_back({"kind", family != properties.end() ? "Absolute" : "WindowsFont"});
+        return output;
+    }
+
+    // Сводит каскад в индекс
+    static Index resolve(const Cascade& cascade) {
+        Index index;
+        for (const auto& item : cascade) {
+            const auto& properties = item.second;
+            bool isColor = properties.count("color") != 0;
+            bool isFont = properties.size() > (isColor ? 1u : 0u);
+            if (isColor && isFont) {
+                throw runtime_error(
+                    properties.at("color").where + ": у элемента стиля " + item.first
+                    + " смешаны свойства цвета и шрифта"
+                );
+            }
+            if (isColor) {
+                index.push_back({item.first, "Color", {{"value", convertColor(properties.at("color"))}}});
+            } else {
+                index.push_back({item.first, "Font", convertFont(properties)});
+            }
+        }
+        return index;
+    }
+
+    vector<Sheet> readSheets(const vector<fs::path>& paths) {
+        vector<Sheet> sheets;
+        for (const auto& path : paths) {
+            sheets.push_back({path, xmltools::readFile(path)});
+        }
+        return sheets;
+    }
+
+    Index compile(const vector<Sheet>& sheets) {
+        trace::Span span("styles", "compile");
+        Cascade cascade;
+        for (const auto& sheet : sheets) {
+            Parser(sheet.text, sheet.path.string(), cascade).parse();
+        }
+        return resolve(cascade);
+    }
+
+    // Хэш таблиц в порядке каскада
+    static string hashSheets(const vector<Sheet>& sheets) {
+        uint64_t hash = 14695981039346656037ull;
+        for (const auto& sheet : sheets) {
+            hash ^= buildcache::hashContent(sheet.text.data(), sheet.text.size());
+            hash *= 1099511628211ull;
+        }
+        char buffer[17];
+        snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(hash));
+        return buffer;
+    }
+
+    // Индекс в файле: имя, тип и пары значения через табуляцию
+    static string serializeIndex(const Index& index, const string& hash) {
+        string text = string(header) + " " + hash + "\n";
+        for (const auto& entry : index) {
+            text += entry.name + "\t" + entry.type;
+            for (const auto& it : entry.value) {
+                text += "\t" + it.first + "=" + it.second;
+            }
+            text += '\n';
+        }
+        return text;
+    }
+
+    // Читает индекс из файла. Возвращает false, если файла нет или он
+    // собран из других таблиц
+    static bool readIndex(const fs::path& path, const string& hash, Index& out) {
+        ifstream input(path);
+        string line;
+        if (!getline(input, line) || line != string(header) + " " + hash) {
+            return false;
+        }
+        Index index;
+        while (getline(input, line)) {
+            vector<string> fields;
+            size_t start = 0;
+            while (true) {
+                size_t tab = line.find('\t', start);
+                fields.push_back(line.substr(start, tab - start));
+                if (tab == string::npos) {
+                    break;
+                }
+                start = tab + 1;
+            }
+            if (fields.size() < 2) {
+                return false;
+            }
+            StyleEntry entry{fields[0], fields[1], {}};
+            for (size_t i = 2; i < fields.size(); i++) {
+                size_t eq = fields[i].find('=');
+                if (eq == string::npos) {
+                    return false;
+                }
+                entry.value.push_back({fields[i].substr(0, eq), fields[i].substr(eq + 1)});
+            }
+            index.push_back(move(entry));
+        }
+        out = move(index);
+        return true;
+    }
+
+    Index load(const vector<Sheet>& sheets, const fs::path& cacheFile) {
+        if (cacheFile.empty()) {
+            return compile(sheets);
+        }
+
+        string hash = hashSheets(sheets);
+        Index index;
+        if (readIndex(cacheFile, hash, index)) {
+            spdlog::debug("Индекс стилей из кэша: {}", cacheFile.string());
+            return index;
+        }
+        index = compile(sheets);
+        buildcache::writeAtomically(serializeIndex(index, hash), cacheFile);
+        return index;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef STYLES_H
+#define STYLES_H
+
+// Таблицы стилей проекта. Правило CSS задаёт элементы стиля 1С:
+//     ВажныйЦвет { color: #C00; }
+//     Заголовок, Подзаголовок { font-family: Arial; font-size: 12pt; font-weight: bold; }
+// Все таблицы разбираются один раз, каскад сводится в плоский индекс
+// элементов стиля
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace std;
+
+namespace styles {
+
+    // Элемент стиля после каскада
+    struct StyleEntry {
+        // Имя элемента стиля
+        string name;
+        // Тип значения: Color или Font
+        string type;
+        // Значение в терминах выгрузки: у цвета - единственная пара
+        // ("value", "#RRGGBB"), у шрифта - атрибуты v8ui:Font
+        vector<pair<string, string>> value;
+    };
+
+    // Плоский индекс, упорядоченный по имени элемента
+    using Index = vector<StyleEntry>;
+
+    // Таблица стилей
+    struct Sheet {
+        // Путь для сообщений об ошибках
+        fs::path path;
+        string text;
+    };
+
+    // Читает таблицы стилей с диска
+    vector<Sheet> readSheets(const vector<fs::path>& paths);
+
+    // Разбирает таблицы стилей sheets (в порядке каскада: последующие
+    // перекрывают предыдущие) и сводит их в индекс. При ошибке бросает
+    // runtime_error с файлом и строкой
+    Index compile(const vector<Sheet>& sheets);
+
+    // То же, но с кэшем на диске: индекс хранится в cacheFile вместе с хэшем
+    // содержимого таблиц и пересобирается, только если хэш изменился.
+    // Пустой cacheFile - без кэша
+    Index load(const vector<Sheet>& sheets, const fs::path& cacheFile);
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include "targets.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+#include "xmltools.hpp"
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace targets {
+
+    const char* const defaultVersion = "2.18";
+
+    static string version = defaultVersion;
+
+    // Версия формата: числа через точку, например 2.18
+    static bool isValidVersion(const string& value) {
+        bool digit = false;
+        for (char c : value) {
+            if (isdigit(static_cast<unsigned char>(c))) {
+                digit = true;
+            } else if (c == '.' && digit) {
+                digit = false;
+            } else {
+                return false;
+            }
+        }
+        return digit && value.find('.') != string::npos;
+    }
+
+    Target parseTarget(const string& spec) {
+        Target target;
+        size_t separator = spec.find('=');
+        if (separator == string::npos) {
+            target.version = defaultVersion;
+            target.directory = spec;
+        } else {
+            target.version = spec.substr(0, separator);
+            target.directory = spec.substr(separator + 1);
+        }
+        if (!isValidVersion(target.version)) {
+            throw runtime_error("Неверная версия формата выгрузки: " + spec);
+        }
+        if (target.directory.empty()) {
+            throw runtime_error("Не указан каталог выгрузки: " + spec);
+        }
+        return target;
+    }
+
+    void setVersion(string value) {
+        version = move(value);
+    }
+
+    const string& getVersion() {
+        return version;
+    }
+
+    const char* getFormat() {
+        return "Hierarchical";
+    }
+
+    // Заменяет в начальном теге корневого элемента text значение атрибута
+    // version на value. Возвращает false, если атрибута нет
+    static bool replaceRootVersion(string& text, const string& value) {
+        // Пропуск объявления XML и комментариев перед корнем
+        size_t start = 0;
+        while (true) {
+            start = text.find('<', start);
+            if (start == string::npos || start + 1 >= text.size()) {
+                return false;
+            }
+            if (text[start + 1] != '?' && text[start + 1] != '!') {
+                break;
+            }
+            start++;
+        }
+        size_t end = text.find('>', start);
+        if (end == string::npos) {
+            return false;
+        }
+        size_t attribute = text.find(" version=\"", start);
+        if (attribute == string::npos || attribute > end) {
+            return false;
+        }
+        size_t valueStart = attribute + 10;
+        size_t valueEnd = text.find('"', valueStart);
+        if (valueEnd == string::npos || valueEnd > end) {
+            return false;
+        }
+        text.replace(valueStart, valueEnd - valueStart, value);
+        return true;
+    }
+
+    Result mirror(const fs::path& source, const Target& target, placement::Mode mode) {
+        trace::Span span("targets", "mirror", target.directory.string());
+        // Каталоги создаются сразу, в том числе пустые
+        vector<fs::path> files;
+        fs::create_directories(target.directory);
+        for (const auto& entry : fs::recursive_directory_iterator(source)) {
+            fs::path relative = fs::relative(entry.path(), source);
+            if (entry.is_directory()) {
+                fs::create_directories(target.directory / relative);
+            } else if (entry.is_regular_file()) {
+                files.push_back(move(relative));
+            }
+        }
+
+        atomic<size_t> rewritten{0};
+        atomic<size_t> placed{0};
+        atomic<size_t> unchanged{0};
+        parallel::forEach(files.size(), [&](size_t i) {
+            fs::path from = source / files[i];
+            fs::path to = target.directory / files[i];
+            if (from.extension() == ".xml" && target.version != version) {
+                string text = xmltools::readFile(from);
+                if (replaceRootVersion(text, target.version)) {
+                    // Совпадающий файл не перезаписывается
+                    if (fs::exists(to) && fs::file_size(to) == text.size()
+                        && xmltools::readFile(to) == text)
+                    {
+                        unchanged++;
+                        return;
+                    }
+                    // Старый файл удаляется: он мог быть жёсткой ссылкой
+                    // на файл основной выгрузки
+                    fs::create_directories(to.parent_path());
+                    fs::remove(to);
+                    ofstream out(to, ios::binary | ios::trunc);
+                    out.write(text.data(), text.size());
+                    if (!out) {
+                        throw runtime_error("Не удалось записать файл: " + to.string());
+                    }
+                    rewritten++;
+                    return;
+                }
+            }
+            if (placement::placeFile(from, to, mode) == placement::Outcome::Unchanged) {
+                unchanged++;
+            } else {
+                placed++;
+            }
+        });
+
+        Result result;
+        result.rewritten = rewritten;
+        result.placed = placed;
+        result.unchanged = unchanged;
+        return result;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef TARGETS_H
+#define TARGETS_H
+
+// Цели выгрузки: каталог и версия формата. Модель собирается один раз и
+// выводится в основную цель, остальные получаются из её файлов: у корневых
+// элементов меняется атрибут version, прочее размещается как есть
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include "placement.hpp"
+
+namespace fs = std::filesystem;
+using namespace std;
+
+namespace targets {
+
+    // Версия формата выгрузки по умолчанию
+    extern const char* const defaultVersion;
+
+    // Цель выгрузки
+    struct Target {
+        // Версия формата: атрибут version корневых элементов и ConfigDumpInfo
+        string version;
+        fs::path directory;
+    };
+
+    // Разбирает значение --target: "каталог" или "версия=каталог",
+    // например 2.17=out/8.3.24
+    Target parseTarget(const string& spec);
+
+    // Версия формата, в которой формируются файлы выгрузки. Задаётся до
+    // начала сборки и общая для всех проектов процесса
+    void setVersion(string version);
+    const string& getVersion();
+
+    // Формат выгрузки ConfigDumpInfo: поддерживается только иерархический
+    const char* getFormat();
+
+    // Что сделано при выводе цели
+    struct Result {
+        // Файлов с переписанной версией
+        size_t rewritten = 0;
+        // Файлов, размещённых как есть
+        size_t placed = 0;
+        // Файлов, уже совпадавших с нужными
+        size_t unchanged = 0;
+    };
+
+    // Выводит цель target из готовой выгрузки source в версии getVersion().
+    // Файлы без версии размещаются способом mode
+    Result mirror(const fs::path& source, const Target& target, placement::Mode mode);
+}
+
+#endif
@@ -0,0 +1,276 @@
+#include "templates.hpp"
+#include "xmltools.hpp"
+#include "textkernel.hpp"
+#include "translations.hpp"
+#include "memstats.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <pugixml.hpp>
+
+namespace templates {
+
+    Template::Template(const string& rendered) {
+        size_t start = 0;
+        size_t pos;
+        while ((pos = rendered.find("{{", start)) != string::npos) {
+            size_t end = rendered.find("}}", pos);
+            if (end == string::npos) {
+                throw logic_error("Незакрытая метка в шаблоне");
+            }
+            size_t slot = stoul(rendered.substr(pos + 2, end - pos - 2));
+
+            // Метка на месте элемента: <{{N}} />
+            bool fragment = pos > 0
+                && rendered[pos - 1] == '<'
+                && rendered.compare(end + 2, 3, " />") == 0;
+            size_t literalEnd = fragment ? pos - 1 : pos;
+            size_t depth = 0;
+            if (fragment) {
+                while (depth < literalEnd && rendered[literalEnd - depth - 1] == '\t') {
+                    depth++;
+                }
+            }
+
+            mParts.push_back({rendered.substr(start, literalEnd - start), slot, depth});
+            start = fragment ? end + 5 : end + 2;
+        }
+        mParts.push_back({rendered.substr(start), noSlot, 0});
+    }
+
+    // Дописывает литерал, сдвигая строки после переводов на depth табуляций
+    static void appendIndented(string& out, const string& literal, size_t depth) {
+        if (depth == 0) {
+            out += literal;
+            return;
+        }
+        const char* data = literal.data();
+        size_t size = literal.size();
+        size_t start = 0;
+        while (start < size) {
+            const void* found = memchr(data + start, '\n', size - start);
+            if (found == nullptr) {
+                out.append(data + start, size - start);
+                return;
+            }
+            size_t end = static_cast<const char*>(found) - data + 1;
+            out.append(data + start, end - start);
+            out.append(depth, '\t');
+            start = end;
+        }
+    }
+
+    void Template::render(string& out, size_t depth, const Fill& fill) const {
+        for (const auto& part : mParts) {
+            appendIndented(out, part.literal, depth);
+            if (part.slot != noSlot) {
+                fill(out, part.slot, depth + part.depth);
+            }
+        }
+    }
+
+    // Метка слота
+    template <typename Slot>
+    static string marker(Slot slot) {
+        return "{{" + to_string(static_cast<size_t>(slot)) + "}}";
+    }
+
+    // Шаблон из документа выгрузки целиком, с объявлением XML
+    static Template compileDocument(const pugi::xml_document& doc) {
+        string rendered;
+        xmltools::serializeDocument(doc, rendered);
+        return Template(rendered);
+    }
+
+    // Шаблон фрагмента: узел без завершающего перевода строки
+    static Template compileNode(pugi::xml_node node) {
+        string rendered;
+        xmltools::serializeNode(node, rendered);
+        rendered.pop_back();
+        return Template(rendered);
+    }
+
+    // Начало документа, как у ObjectNode::createDocument
+    static pugi::xml_node createMetaDataObject(pugi::xml_document& doc) {
+        pugi::xml_node md = doc.append_child("MetaDataObject");
+        xmltools::addNamespaces(md);
+        return md;
+    }
+
+    // Сгенерированный тип, как у xmltools::addGeneratedType
+    static void addGeneratedType(pugi::xml_node node, const string& name, const string& category, const string& uuid) {
+        pugi::xml_node generatedType = node.append_child("xr:GeneratedType");
+        generatedType.append_attribute("name").set_value(name.c_str());
+        generatedType.append_attribute("category").set_value(category.c_str());
+        generatedType.append_child("xr:TypeId").text().set(uuid.c_str());
+        generatedType.append_child("xr:ValueId").text().set(uuid.c_str());
+    }
+
+    static Template makeObject(const string& kind) {
+        pugi::xml_document doc;
+        pugi::xml_node obj = createMetaDataObject(doc).append_child(kind.c_str());
+        obj.append_attribute("uuid").set_value(marker(ObjectSlot::Uuid).c_str());
+
+        pugi::xml_node internalInfo = obj.append_child("InternalInfo");
+        for (const char* category : {"Object", "Ref", "Selection", "List", "Manager"}) {
+            addGeneratedType(
+                internalInfo,
+                kind + category + "." + marker(ObjectSlot::TypeName),
+                category,
+                marker(ObjectSlot::RandomUuid)
+            );
+        }
+
+        pugi::xml_node properties = obj.append_child("Properties");
+        properties.append_child(marker(ObjectSlot::Name).c_str());
+        properties.append_child(marker(ObjectSlot::Synonym).c_str());
+        properties.append_child(marker(ObjectSlot::Comment).c_str());
+        obj.append_child(marker(ObjectSlot::Children).c_str());
+        return compileDocument(doc);
+    }
+
+    const Template& getObject(const string& kind) {
+        static const Template catalog = makeObject("Catalog");
+        static const Template document = makeObject("Document");
+        if (kind == "Catalog") {
+            return catalog;
+        }
+        if (kind == "Document") {
+            return document;
+        }
+        throw logic_error("Нет шаблона для объекта " + kind);
+    }
+
+    const Template& getLanguage() {
+        static const Template language = []() {
+            pugi::xml_document doc;
+            pugi::xml_node obj = createMetaDataObject(doc).append_child("Language");
+            obj.append_attribute("uuid").set_value(marker(LanguageSlot::Uuid).c_str());
+            pugi::xml_node properties = obj.append_child("Properties");
+            properties.append_child(marker(LanguageSlot::Name).c_str());
+            properties.append_child(marker(LanguageSlot::Synonym).c_str());
+            properties.append_child(marker(LanguageSlot::Comment).c_str());
+            properties.append_child(marker(LanguageSlot::Code).c_str());
+            return compileDocument(doc);
+        }();
+        return language;
+    }
+
+    const Template& getAttribute() {
+        static const Template attribute = []() {
+            pugi::xml_document doc;
+            pugi::xml_node output = doc.append_child("Attribute");
+            pugi::xml_node properties = output.append_child("Properties");
+            output.append_attribute("uuid").set_value(marker(AttributeSlot::Uuid).c_str());
+            properties.append_child(marker(AttributeSlot::Name).c_str());
+            properties.append_child(marker(AttributeSlot::Synonym).c_str());
+            properties.append_child(marker(AttributeSlot::Comment).c_str());
+            properties.append_child(marker(AttributeSlot::Type).c_str());
+            return compileNode(output);
+        }();
+        return attribute;
+    }
+
+    const Template& getTabularSection() {
+        static const Template tabularSection = []() {
+            pugi::xml_document doc;
+            pugi::xml_node output = doc.append_child("TabularSection");
+            output.append_attribute("uuid").set_value(marker(TabularSlot::Uuid).c_str());
+            pugi::xml_node internalInfo = output.append_child("InternalInfo");
+            pugi::xml_node properties = output.append_child("Properties");
+            addGeneratedType(
+                internalInfo,
+                marker(TabularSlot::TypeName),
+                "TabularSection",
+                marker(TabularSlot::RandomUuid)
+            );
+            addGeneratedType(
+                internalInfo,
+                marker(TabularSlot::RowTypeName),
+                "TabularSectionRow",
+                marker(TabularSlot::RandomUuid)
+            );
+            properties.append_child(marker(TabularSlot::Name).c_str());
+            properties.append_child(marker(TabularSlot::Synonym).c_str());
+            properties.append_child(marker(TabularSlot::Comment).c_str());
+            output.append_child(marker(TabularSlot::Children).c_str());
+            return compileNode(output);
+        }();
+        return tabularSection;
+    }
+
+    // Элемент локализованной строки: слот 0 - код языка, 1 - текст
+    static const Template& getLocalisedItem() {
+        static const Template item = []() {
+            pugi::xml_document doc;
+            pugi::xml_node v8item = doc.append_child("v8:item");
+            v8item.append_child("v8:lang").text().set(marker(0).c_str());
+            v8item.append_child("v8:content").text().set(marker(1).c_str());
+            return compileNode(v8item);
+        }();
+        return item;
+    }
+
+    void appendLineBreak(string& out, size_t depth) {
+        out += '\n';
+        out.append(depth, '\t');
+    }
+
+    void appendSubNode(string& out, const char* name, const string& value) {
+        out += '<';
+        out += name;
+        if (value.empty()) {
+            out += " />";
+            return;
+        }
+        out += '>';
+        xmltools::appendEscaped(out, value, false);
+        out += "</";
+        out += name;
+        out += '>';
+    }
+
+    void appendLocalisedString(
+        string& out,
+        size_t depth,
+        const char* name,
+        const lstring& langMap)
+    {
+        out += '<';
+        out += name;
+        if (langMap.empty()) {
+            out += " />";
+            return;
+        }
+        out += '>';
+        const Template& item = getLocalisedItem();
+        translations::forEachItem(langMap, [&](const string& lang, string_view text) {
+            appendLineBreak(out, depth + 1);
+            item.render(out, depth + 1, [&](string& out, size_t slot, size_t) {
+                if (slot == 0) {
+                    xmltools::appendEscaped(out, lang, false);
+                } else if (!textkernel::appendEscaped(out, text.data(), text.size(), false)) {
+                    throw runtime_error("Некорректный UTF-8: " + string(text));
+                }
+            });
+        });
+        appendLineBreak(out, depth);
+        out += "</";
+        out += name;
+        out += '>';
+    }
+
+    void appendType(string& out, size_t depth, typing::Type& type) {
+        // Временный документ не относится к DOM выгружаемого объекта:
+        // вложенный замер исключает его из замера объекта
+        memstats::DomMeter scratchMeter;
+        static thread_local pugi::xml_document scratch;
+        scratch.reset();
+        pugi::xml_node holder = scratch.append_child("Properties");
+        type.addTypeNode(holder);
+
+        string rendered;
+        xmltools::serializeNode(holder.first_child(), rendered);
+        rendered.pop_back();
+        appendIndented(out, rendered, depth);
+    }
+}
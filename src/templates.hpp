@@ -0,0 +1,119 @@
+#ifndef TEMPLATES_H
+#define TEMPLATES_H
+
+// Заготовки файлов выгрузки. Каждый шаблон один раз строится через DOM с
+// метками слотов {{N}} и сериализуется, дальше выгрузка объекта - это
+// копирование готовых байтов и заполнение слотов
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include "localised.hpp"
+#include "typing.hpp"
+
+using namespace std;
+
+namespace templates {
+
+    // Выводит слот номер slot. Для слотов-фрагментов (меток на месте
+    // элемента) depth - уровень вложенности этого элемента
+    using Fill = function<void(string& out, size_t slot, size_t depth)>;
+
+    // Скомпилированный шаблон: литералы между слотами
+    class Template {
+        public:
+        // Компилирует сериализованный текст с метками слотов. Метка на месте
+        // элемента (<{{N}} />) становится фрагментом, остальные - текстом
+        explicit Template(const string& rendered);
+
+        // Выводит шаблон, сдвигая все строки кроме первой на depth табуляций
+        void render(string& out, size_t depth, const Fill& fill) const;
+
+        private:
+        struct Part {
+            // Текст перед слотом
+            string literal;
+            // Номер слота или noSlot для хвоста шаблона
+            size_t slot;
+            // Уровень вложенности фрагмента внутри шаблона
+            size_t depth;
+        };
+        static const size_t noSlot = static_cast<size_t>(-1);
+        vector<Part> mParts;
+    };
+
+    // Слоты справочника и документа
+    enum class ObjectSlot : size_t {
+        // uuid объекта
+        Uuid,
+        // Имя в атрибутах name сгенерированных типов
+        TypeName,
+        // Случайный UUID (TypeId, ValueId)
+        RandomUuid,
+        // Фрагменты <Name>, <Synonym>, <Comment>, <ChildObjects>
+        Name,
+        Synonym,
+        Comment,
+        Children
+    };
+
+    // Слоты языка
+    enum class LanguageSlot : size_t {
+        Uuid,
+        Name,
+        Synonym,
+        Comment,
+        Code
+    };
+
+    // Слоты реквизита и колонки табличной части
+    enum class AttributeSlot : size_t {
+        Uuid,
+        Name,
+        Synonym,
+        Comment,
+        // Фрагмент <Type>
+        Type
+    };
+
+    // Слоты табличной части
+    enum class TabularSlot : size_t {
+        Uuid,
+        // Полные имена сгенерированных типов табличной части и её строки
+        TypeName,
+        RowTypeName,
+        RandomUuid,
+        Name,
+        Synonym,
+        Comment,
+        Children
+    };
+
+    // Шаблон документа справочника (kind = "Catalog") или документа
+    // (kind = "Document")
+    const Template& getObject(const string& kind);
+
+    // Шаблоны документа языка, реквизита и табличной части
+    const Template& getLanguage();
+    const Template& getAttribute();
+    const Template& getTabularSection();
+
+    // Перевод строки и отступ на уровень depth
+    void appendLineBreak(string& out, size_t depth);
+
+    // Фрагмент как у xmltools::addSubNode: пустое значение - пустой элемент
+    void appendSubNode(string& out, const char* name, const string& value);
+
+    // Фрагмент локализованной строки как у xmltools::addLocalisedString
+    void appendLocalisedString(
+        string& out,
+        size_t depth,
+        const char* name,
+        const lstring& langMap);
+
+    // Фрагмент <Type>. Типы немногочисленны по форме, поэтому узел
+    // строится через DOM во временном документе потока
+    void appendType(string& out, size_t depth, typing::Type& type);
+}
+
+#endif
@@ -0,0 +1,351 @@
+#include "textkernel.hpp"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TEXTKERNEL_X86
+#include <immintrin.h>
+#endif
+
+namespace textkernel {
+
+    // Экранирует байты по правилам pugixml: в тексте & < > и управляющие
+    // символы кроме \t \r \n, в атрибутах & < " и все управляющие символы
+    static void escapeScalar(string& out, const char* data, size_t size, bool attribute) {
+        for (size_t i = 0; i < size; i++) {
+            char c = data[i];
+            unsigned char ch = static_cast<unsigned char>(c);
+            switch (c) {
+                case '&': out += "&amp;"; break;
+                case '<': out += "&lt;"; break;
+                case '>':
+                    if (attribute) out += c;
+                    else out += "&gt;";
+                    break;
+                case '"':
+                    if (attribute) out += "&quot;";
+                    else out += c;
+                    break;
+                default:
+                    if (ch < 32 && (attribute || (c != '\t' && c != '\r' && c != '\n'))) {
+                        out += "&#";
+                        out += static_cast<char>('0' + ch / 10);
+                        out += static_cast<char>('0' + ch % 10);
+                        out += ';';
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+    }
+
+    // Проверка UTF-8 по одной кодовой точке: длина последовательности,
+    // продолжения, слишком длинная запись, суррогаты и предел U+10FFFF
+    static bool validateScalar(const char* data, size_t size) {
+        const unsigned char* s = reinterpret_cast<const unsigned char*>(data);
+        size_t i = 0;
+        while (i < size) {
+            unsigned char c = s[i];
+            if (c < 0x80) {
+                i++;
+                continue;
+            }
+            size_t length;
+            uint32_t codePoint;
+            uint32_t minimum;
+            if ((c & 0xE0) == 0xC0) {
+                length = 2;
+                codePoint = c & 0x1F;
+                minimum = 0x80;
+            } else if ((c & 0xF0) == 0xE0) {
+                length = 3;
+                codePoint = c & 0x0F;
+                minimum = 0x800;
+            } else if ((c & 0xF8) == 0xF0) {
+                length = 4;
+                codePoint = c & 0x07;
+                minimum = 0x10000;
+            } else {
+                return false;
+            }
+            if (size - i < length) {
+                return false;
+            }
+            for (size_t k = 1; k < length; k++) {
+                if ((s[i + k] & 0xC0) != 0x80) {
+                    return false;
+                }
+                codePoint = (codePoint << 6) | (s[i + k] & 0x3F);
+            }
+            if (codePoint < minimum
+                || codePoint > 0x10FFFF
+                || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+                return false;
+            }
+            i += length;
+        }
+        return true;
+    }
+
+    namespace scalar {
+
+        static bool appendEscaped(string& out, const char* data, size_t size, bool attribute) {
+            escapeScalar(out, data, size, attribute);
+            return validateScalar(data, size);
+        }
+
+        static bool isValidUtf8(const char* data, size_t size) {
+            return validateScalar(data, size);
+        }
+    }
+
+#ifdef TEXTKERNEL_X86
+    // Проверка UTF-8 по 32 байта за шаг: таблицы по старшим и младшим
+    // полубайтам соседних байтов (алгоритм Keiser-Lemire, как в simdjson).
+    // Каждый бит таблиц обозначает класс ошибки; ошибка есть, если бит
+    // остался во всех трёх таблицах
+    namespace avx2 {
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+        static const uint8_t TOO_SHORT = 1 << 0;
+        static const uint8_t TOO_LONG = 1 << 1;
+        static const uint8_t OVERLONG_3 = 1 << 2;
+        static const uint8_t TOO_LARGE = 1 << 3;
+        static const uint8_t SURROGATE = 1 << 4;
+        static const uint8_t OVERLONG_2 = 1 << 5;
+        static const uint8_t TOO_LARGE_1000 = 1 << 6;
+        static const uint8_t OVERLONG_4 = 1 << 6;
+        static const uint8_t TWO_CONTS = 1 << 7;
+        static const uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+        // Старший полубайт первого байта пары
+        alignas(16) static const uint8_t byte1High[16] = {
+            // 0xxx: ASCII
+            TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+            TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+            // 10xx: продолжение
+            TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+            // 1100: начало двухбайтовой
+            TOO_SHORT | OVERLONG_2,
+            // 1101: начало двухбайтовой
+            TOO_SHORT,
+            // 1110: начало трёхбайтовой
+            TOO_SHORT | OVERLONG_3 | SURROGATE,
+            // 1111: начало четырёхбайтовой
+            TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+        };
+
+        // Младший полубайт первого байта пары
+        alignas(16) static const uint8_t byte1Low[16] = {
+            CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+            CARRY | OVERLONG_2,
+            CARRY,
+            CARRY,
+            CARRY | TOO_LARGE,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000
+        };
+
+        // Старший полубайт второго байта пары
+        alignas(16) static const uint8_t byte2High[16] = {
+            // 0xxx: ASCII
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+            // 1000
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+            // 1001
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+            // 101x
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+            TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+            // 11xx: начало последовательности
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+        };
+
+        // Последние три байта блока не могут начинать последовательность,
+        // которая не умещается в блок
+        static const uint8_t incompleteLimit[32] = {
+            255, 255, 255, 255, 255, 255, 255, 255,
+            255, 255, 255, 255, 255, 255, 255, 255,
+            255, 255, 255, 255, 255, 255, 255, 255,
+            255, 255, 255, 255, 255, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1
+        };
+
+        struct Utf8State {
+            __m256i error;
+            __m256i prevInput;
+            __m256i prevIncomplete;
+        };
+
+        AVX2_TARGET static inline __m256i table(const uint8_t* values) {
+            return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(values)));
+        }
+
+        AVX2_TARGET static inline __m256i highNibble(__m256i v) {
+            return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+        }
+
+        // Байты блока, сдвинутые на N назад, с хвостом предыдущего блока
+        template <int N>
+        AVX2_TARGET static inline __m256i prev(__m256i input, __m256i prevInput) {
+            return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prevInput, input, 0x21), 16 - N);
+        }
+
+        AVX2_TARGET static inline void checkBlock(__m256i input, Utf8State& state) {
+            if (_mm256_movemask_epi8(input) == 0) {
+                // Только ASCII: ошибка, если предыдущий блок оборвался
+                state.error = _mm256_or_si256(state.error, state.prevIncomplete);
+                state.prevIncomplete = _mm256_setzero_si256();
+                state.prevInput = input;
+                return;
+            }
+
+            __m256i prev1 = prev<1>(input, state.prevInput);
+            __m256i special = _mm256_and_si256(
+                _mm256_and_si256(
+                    _mm256_shuffle_epi8(table(byte1High), highNibble(prev1)),
+                    _mm256_shuffle_epi8(table(byte1Low), _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)))
+                ),
+                _mm256_shuffle_epi8(table(byte2High), highNibble(input))
+            );
+
+            // Третий и четвёртый байты должны быть продолжениями
+            __m256i prev2 = prev<2>(input, state.prevInput);
+            __m256i prev3 = prev<3>(input, state.prevInput);
+            __m256i isThird = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+            __m256i isFourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+            __m256i must23 = _mm256_and_si256(
+                _mm256_or_si256(isThird, isFourth),
+                _mm256_set1_epi8(static_cast<char>(0x80))
+            );
+
+            state.error = _mm256_or_si256(state.error, _mm256_xor_si256(must23, special));
+            state.prevIncomplete = _mm256_subs_epu8(
+                input,
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(incompleteLimit))
+            );
+            state.prevInput = input;
+        }
+
+        // Маска байтов блока, требующих экранирования
+        AVX2_TARGET static inline uint32_t specialMask(__m256i input, bool attribute) {
+            __m256i control = _mm256_cmpeq_epi8(
+                _mm256_max_epu8(input, _mm256_set1_epi8(31)),
+                _mm256_set1_epi8(31)
+            );
+            if (!attribute) {
+                __m256i whitespace = _mm256_or_si256(
+                    _mm256_or_si256(
+                        _mm256_cmpeq_epi8(input, _mm256_set1_epi8('\t')),
+                        _mm256_cmpeq_epi8(input, _mm256_set1_epi8('\n'))
+                    ),
+                    _mm256_cmpeq_epi8(input, _mm256_set1_epi8('\r'))
+                );
+                control = _mm256_andnot_si256(whitespace, control);
+            }
+            __m256i special = _mm256_or_si256(
+                _mm256_or_si256(
+                    _mm256_cmpeq_epi8(input, _mm256_set1_epi8('&')),
+                    _mm256_cmpeq_epi8(input, _mm256_set1_epi8('<'))
+                ),
+                _mm256_cmpeq_epi8(input, _mm256_set1_epi8(attribute ? '"' : '>'))
+            );
+            return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(control, special)));
+        }
+
+        AVX2_TARGET static inline bool finish(Utf8State& state) {
+            __m256i error = _mm256_or_si256(state.error, state.prevIncomplete);
+            return _mm256_testz_si256(error, error) != 0;
+        }
+
+        AVX2_TARGET static bool appendEscaped(string& out, const char* data, size_t size, bool attribute) {
+            Utf8State state{_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+            out.reserve(out.size() + size);
+
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                checkBlock(input, state);
+                if (specialMask(input, attribute) == 0) {
+                    out.append(data + i, 32);
+                } else {
+                    escapeScalar(out, data + i, 32, attribute);
+                }
+            }
+
+            // Хвост дополняется нулями: нули - ASCII и обрыв последовательности
+            // перед ними проверка заметит
+            if (i < size) {
+                alignas(32) char tail[32] = {};
+                size_t rest = size - i;
+                memcpy(tail, data + i, rest);
+                __m256i input = _mm256_load_si256(reinterpret_cast<const __m256i*>(tail));
+                checkBlock(input, state);
+                uint32_t mask = specialMask(input, attribute) & ((1u << rest) - 1);
+                if (mask == 0) {
+                    out.append(data + i, rest);
+                } else {
+                    escapeScalar(out, data + i, rest, attribute);
+                }
+            }
+
+            return finish(state);
+        }
+
+        AVX2_TARGET static bool isValidUtf8(const char* data, size_t size) {
+            Utf8State state{_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                checkBlock(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), state);
+            }
+            if (i < size) {
+                alignas(32) char tail[32] = {};
+                memcpy(tail, data + i, size - i);
+                checkBlock(_mm256_load_si256(reinterpret_cast<const __m256i*>(tail)), state);
+            }
+            return finish(state);
+        }
+
+#undef AVX2_TARGET
+    }
+#endif
+
+    vector<Kernel> getKernels() {
+        vector<Kernel> kernels{{"scalar", &scalar::appendEscaped, &scalar::isValidUtf8}};
+#ifdef TEXTKERNEL_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            kernels.push_back({"avx2", &avx2::appendEscaped, &avx2::isValidUtf8});
+        }
+#endif
+        return kernels;
+    }
+
+    // Выбранная реализация: самая быстрая из доступных
+    static const Kernel& select() {
+        static const Kernel kernel = getKernels().back();
+        return kernel;
+    }
+
+    bool appendEscaped(string& out, const char* data, size_t size, bool attribute) {
+        return select().appendEscaped(out, data, size, attribute);
+    }
+
+    bool isValidUtf8(const char* data, size_t size) {
+        return select().isValidUtf8(data, size);
+    }
+
+    const char* getImplementation() {
+        return select().name;
+    }
+}
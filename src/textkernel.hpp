@@ -0,0 +1,38 @@
+#ifndef TEXTKERNEL_H
+#define TEXTKERNEL_H
+
+// Ядро вывода текста: проверка UTF-8 и экранирование XML за один проход.
+// Реализация выбирается при первом вызове по возможностям процессора
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace textkernel {
+
+    // Дописывает к out data с экранированием, как это делает pugixml.
+    // attribute - экранировать как значение атрибута (иначе как текст узла).
+    // Возвращает false, если data не является корректным UTF-8;
+    // экранированный текст при этом всё равно дописывается
+    bool appendEscaped(string& out, const char* data, size_t size, bool attribute);
+
+    // Проверяет, что data - корректный UTF-8
+    bool isValidUtf8(const char* data, size_t size);
+
+    // Название выбранной реализации: "avx2" или "scalar"
+    const char* getImplementation();
+
+    // Реализация ядра
+    struct Kernel {
+        const char* name;
+        bool (*appendEscaped)(string& out, const char* data, size_t size, bool attribute);
+        bool (*isValidUtf8)(const char* data, size_t size);
+    };
+
+    // Реализации, доступные на этом процессоре; первая - эталонная scalar.
+    // Для проверок, сравнивающих реализации между собой
+    vector<Kernel> getKernels();
+}
+
+#endif
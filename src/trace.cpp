@@ -0,0 +1,131 @@
+#include "trace.hpp"
+#include "jsontools.hpp"
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include <unistd.h>
+
+namespace trace {
+
+    // Завершённый отрезок
+    struct Event {
+        const char* category;
+        const char* name;
+        string detail;
+        chrono::steady_clock::time_point start;
+        chrono::steady_clock::time_point end;
+    };
+
+    // События одного потока. Принадлежат общему списку, поэтому
+    // переживают завершение потока
+    struct ThreadBuffer {
+        int threadId;
+        vector<Event> events;
+    };
+
+    static atomic<bool> enabled{false};
+    static chrono::steady_clock::time_point origin;
+    static mutex buffersMutex;
+    static vector<shared_ptr<ThreadBuffer>> buffers;
+
+    // Буфер текущего потока, создаётся при первом событии
+    static ThreadBuffer& threadBuffer() {
+        thread_local shared_ptr<ThreadBuffer> buffer;
+        if (!buffer) {
+            lock_guard<mutex> lock(buffersMutex);
+            buffer = make_shared<ThreadBuffer>();
+            buffer->threadId = (int)buffers.size() + 1;
+            buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    void enable() {
+        origin = chrono::steady_clock::now();
+        enabled = true;
+    }
+
+    bool isEnabled() {
+        return enabled.load(memory_order_relaxed);
+    }
+
+    Span::Span(const char* category, const char* name)
+        : mCategory{category}
+        , mName{name}
+        , mDetail{}
+        , mActive{isEnabled()}
+    {
+        if (mActive) {
+            mStart = chrono::steady_clock::now();
+        }
+    }
+
+    Span::Span(const char* category, const char* name, const string& detail)
+        : mCategory{category}
+        , mName{name}
+        , mDetail{}
+        , mActive{isEnabled()}
+    {
+        if (mActive) {
+            mDetail = detail;
+            mStart = chrono::steady_clock::now();
+        }
+    }
+
+    Span::~Span() {
+        if (!mActive) {
+            return;
+        }
+        threadBuffer().events.push_back({
+            mCategory,
+            mName,
+            move(mDetail),
+            mStart,
+            chrono::steady_clock::now()
+        });
+    }
+
+    void write(fs::path path) {
+        ofstream out(path, ios::binary | ios::trunc);
+        if (!out) {
+            throw runtime_error("Не удалось открыть файл трассировки: " + path.string());
+        }
+
+        // Целые микросекунды: у double с точностью по умолчанию длинные
+        // сборки выводились бы в экспоненциальной записи
+        auto micros = [](chrono::steady_clock::duration d) {
+            return static_cast<long long>(chrono::duration_cast<chrono::microseconds>(d).count());
+        };
+
+        lock_guard<mutex> lock(buffersMutex);
+        int pid = (int)getpid();
+        bool first = true;
+        out << "{\"traceEvents\":[\n";
+        for (const auto& buffer : buffers) {
+            for (const auto& e : buffer->events) {
+                if (!first) {
+                    out << ",\n";
+                }
+                first = false;
+                out << "{\"ph\":\"X\",\"cat\":";
+                out << jsontools::quote(e.category);
+                out << ",\"name\":";
+                out << jsontools::quote(e.name);
+                out << ",\"pid\":" << pid
+                    << ",\"tid\":" << buffer->threadId
+                    << ",\"ts\":" << micros(e.start - origin)
+                    << ",\"dur\":" << micros(e.end - e.start);
+                if (!e.detail.empty()) {
+                    out << ",\"args\":{\"detail\":";
+                    out << jsontools::quote(e.detail);
+                    out << "}";
+                }
+                out << "}";
+            }
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    }
+}
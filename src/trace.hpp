@@ -0,0 +1,45 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Трассировка этапов сборки в формате Chrome trace-event
+// (открывается в chrome://tracing и Perfetto)
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+namespace trace {
+
+    // Включает запись событий. До вызова все отрезки ничего не стоят
+    void enable();
+
+    // Включена ли запись
+    bool isEnabled();
+
+    // Отрезок времени: начинается при создании, заканчивается при уничтожении.
+    // category и name должны жить до конца программы (строковые литералы),
+    // detail копируется только при включённой трассировке
+    class Span {
+        public:
+        Span(const char* category, const char* name);
+        Span(const char* category, const char* name, const string& detail);
+        ~Span();
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+        private:
+        const char* mCategory;
+        const char* mName;
+        string mDetail;
+        bool mActive;
+        chrono::steady_clock::time_point mStart;
+    };
+
+    // Записывает накопленные события всех потоков в файл
+    void write(fs::path path);
+}
+
+#endif
@@ -0,0 +1,338 @@
+#include "translations.hpp"
+#include "buildcache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <spdlog/spdlog.h>
+
+namespace translations {
+
+    // Размер блока общей области строк
+    static const size_t blockSize = 64 * 1024;
+
+    Table::Table(string sourceLanguage, vector<string> languages, const Table* fallback)
+        : mSourceLanguage{sourceLanguage}
+        , mAllowed{languages}
+        , mFallback{fallback}
+        , mBlockUsed{0}
+        , mBlockSize{0}
+        , mFingerprint{fallback == nullptr ? 0 : fallback->getFingerprint()} {}
+
+    string_view Table::intern(string_view text) {
+        if (text.empty()) {
+            return {};
+        }
+        auto found = mInterned.find(text);
+        if (found != mInterned.end()) {
+            return *found;
+        }
+        if (text.size() > mBlockSize - mBlockUsed) {
+            // Длинные строки получают собственный блок
+            mBlockSize = max(blockSize, text.size());
+            mBlocks.push_back(make_unique<char[]>(mBlockSize));
+            mBlockUsed = 0;
+        }
+        char* data = mBlocks.back().get() + mBlockUsed;
+        memcpy(data, text.data(), text.size());
+        mBlockUsed += text.size();
+        string_view output(data, text.size());
+        mInterned.insert(output);
+        return output;
+    }
+
+    void Table::add(string_view source, size_t language, string_view text) {
+        mEntries.push_back({intern(source), static_cast<uint32_t>(language), intern(text)});
+    }
+
+    // Разбирает строку .po в кавычках начиная с позиции start
+    static string unquote(const string& line, size_t start) {
+        size_t open = line.find('"', start);
+        size_t close = line.find_last_of('"');
+        if (open == string::npos || close == open
+            || line.find_first_not_of(" \t", start) != open
+            || line.find_first_not_of(" \t", close + 1) != string::npos)
+        {
+            throw runtime_error("ожидается строка в кавычках");
+        }
+        string output;
+        for (size_t i = open + 1; i < close; i++) {
+            char c = line[i];
+            if (c != '\\') {
+                output += c;
+                continue;
+            }
+            if (++i == close) {
+                throw runtime_error("незавершённая escape-последовательность");
+            }
+            switch (line[i]) {
+                case 'n': output += '\n'; break;
+                case 't': output += '\t'; break;
+                case 'r': output += '\r'; break;
+                case '"': output += '"'; break;
+                case '\\': output += '\\'; break;
+                default:
+                    throw runtime_error(string("неизвестная escape-последовательность \\") + line[i]);
+            }
+        }
+        return output;
+    }
+
+    // Язык из заголовка файла .po (строка "Language: xx")
+    static string getHeaderLanguage(const string& header) {
+        size_t start = 0;
+        while (start < header.size()) {
+            size_t end = header.find('\n', start);
+            if (end == string::npos) {
+                end = header.size();
+            }
+            string line = header.substr(start, end - start);
+            if (line.compare(0, 9, "Language:") == 0) {
+                size_t first = line.find_first_not_of(" \t", 9);
+                size_t last = line.find_last_not_of(" \t\r");
+                return first == string::npos ? "" : line.substr(first, last - first + 1);
+            }
+            start = end + 1;
+        }
+        return "";
+    }
+
+    bool Table::load(const fs::path& path) {
+        ifstream input(path, ios::binary);
+        if (!input) {
+            throw runtime_error("Не удалось открыть файл переводов: " + path.string());
+        }
+
+        // Поля текущей записи
+        enum class Field { None, Context, Id, Plural, Str, OtherStr };
+        Field field = Field::None;
+        string context, id, str;
+        bool hasContext = false;
+        bool fuzzy = false;
+        bool hasEntry = false;
+        // Индекс языка файла, пока заголовок не прочитан - npos
+        size_t language = string::npos;
+        bool skipped = false;
+
+        auto flush = [&]() {
+            if (!hasEntry) {
+                return;
+            }
+            if (id.empty() && !hasContext) {
+                // Заголовок
+                string code = getHeaderLanguage(str);
+                if (code.empty()) {
+                    throw runtime_error("в заголовке не указан язык (Language)");
+                }
+                if (find(mAllowed.begin(), mAllowed.end(), code) == mAllowed.end()) {
+                    skipped = true;
+                } else {
+                    auto it = find(mLanguages.begin(), mLanguages.end(), code);
+                    language = it - mLanguages.begin();
+                    if (it == mLanguages.end()) {
+                        mLanguages.push_back(code);
+                    }
+                }
+            } else if (language == string::npos) {
+                throw runtime_error("запись до заголовка с языком (Language)");
+            } else if (!fuzzy && !hasContext && !str.empty()) {
+                // Записи с msgctxt не поддерживаются: синоним не несёт контекста
+                add(id, language, str);
+            }
+            field = Field::None;
+            context.clear();
+            id.clear();
+            str.clear();
+            hasContext = false;
+            fuzzy = false;
+            hasEntry = false;
+        };
+
+        string line;
+        size_t lineNumber = 0;
+        try {
+            while (!skipped && getline(input, line)) {
+                lineNumber++;
+                mFingerprint = (mFingerprint ^ buildcache::hashContent(line.data(), line.size()))
+                    * 1099511628211ull;
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                size_t first = line.find_first_not_of(" \t");
+                if (first == string::npos) {
+                    flush();
+                    continue;
+                }
+                if (line[first] == '#') {
+                    // Устаревшие записи (#~) и комментарии пропускаются
+                    if (line.compare(first, 2, "#,") == 0 && line.find("fuzzy", first) != string::npos) {
+                        flush();
+                        fuzzy = true;
+                    }
+                    continue;
+                }
+                if (line[first] == '"') {
+                    string part = unquote(line, first);
+                    switch (field) {
+                        case Field::Context: context += part; break;
+                        case Field::Id: id += part; break;
+                        case Field::Str: str += part; break;
+                        case Field::Plural:
+                        case Field::OtherStr: break;
+                        case Field::None:
+                            throw runtime_error("продолжение строки без ключевого слова");
+                    }
+                    continue;
+                }
+
+                size_t end = line.find_first_of(" \t", first);
+                string keyword = line.substr(first, end == string::npos ? string::npos : end - first);
+                if (end == string::npos) {
+                    throw runtime_error("ожидается строка после " + keyword);
+                }
+                if (keyword == "msgctxt") {
+                    if (field != Field::None) {
+                        flush();
+                    }
+                    hasEntry = true;
+                    hasContext = true;
+                    field = Field::Context;
+                    context = unquote(line, end);
+                } else if (keyword == "msgid") {
+                    if (field != Field::None && field != Field::Context) {
+                        flush();
+                    }
+                    hasEntry = true;
+                    field = Field::Id;
+                    id = unquote(line, end);
+                } else if (keyword == "msgid_plural") {
+                    field = Field::Plural;
+                } else if (keyword == "msgstr" || keyword == "msgstr[0]") {
+                    field = Field::Str;
+                    str = unquote(line, end);
+                } else if (keyword.compare(0, 7, "msgstr[") == 0) {
+                    // Остальные формы множественного числа не нужны
+                    field = Field::OtherStr;
+                } else {
+                    throw runtime_error("неизвестное ключевое слово " + keyword);
+                }
+            }
+            if (!skipped) {
+                flush();
+            }
+        } catch (const runtime_error& e) {
+            throw runtime_error(path.string() + ":" + to_string(lineNumber) + ": " + e.what());
+        }
+
+        if (skipped) {
+            spdlog::info("Файл переводов пропущен: язык не входит в конфигурацию: {}", path.string());
+            return false;
+        }
+
+        // Упорядочение для поиска. Из повторов остаётся загруженный последним
+        stable_sort(mEntries.begin(), mEntries.end(), [](const Entry& a, const Entry& b) {
+            return a.source != b.source ? a.source < b.source : a.language < b.language;
+        });
+        vector<Entry> unique;
+        unique.reserve(mEntries.size());
+        for (const auto& entry : mEntries) {
+            if (!unique.empty()
+                && unique.back().source == entry.source
+                && unique.back().language == entry.language)
+            {
+                unique.back() = entry;
+            } else {
+                unique.push_back(entry);
+            }
+        }
+        mEntries = move(unique);
+        return true;
+    }
+
+    const string& Table::getSourceLanguage() const {
+        return mSourceLanguage;
+    }
+
+    void Table::forEachTranslation(
+        string_view source,
+        const vector<string_view>& skip,
+        const function<void(const string&, string_view)>& fn) const
+    {
+        auto begin = lower_bound(
+            mEntries.begin(),
+            mEntries.end(),
+            source,
+            [](const Entry& entry, string_view value) {
+                return entry.source < value;
+            }
+        );
+        vector<string_view> emitted = skip;
+        for (auto it = begin; it != mEntries.end() && it->source == source; ++it) {
+            const string& language = mLanguages[it->language];
+            if (find(emitted.begin(), emitted.end(), language) != emitted.end()) {
+                continue;
+            }
+            fn(language, it->text);
+            emitted.push_back(language);
+        }
+        if (mFallback != nullptr) {
+            mFallback->forEachTranslation(source, emitted, fn);
+        }
+    }
+
+    size_t Table::size() const {
+        return mEntries.size();
+    }
+
+    uint64_t Table::getFingerprint() const {
+        return mFingerprint;
+    }
+
+    static thread_local const Table* active = nullptr;
+
+    const Table* getActive() {
+        return active;
+    }
+
+    void forEachItem(
+        const lstring& strings,
+        const function<void(const string&, string_view)>& fn)
+    {
+        string_view source;
+        if (active == nullptr || !strings.find(active->getSourceLanguage(), source)) {
+            strings.forEach(fn);
+            return;
+        }
+
+        // Собственные строки и переводы сливаются в общий порядок кодов
+        vector<pair<const string*, string_view>> items;
+        vector<string_view> own;
+        strings.forEach([&](const string& language, string_view text) {
+            items.push_back({&language, text});
+            own.push_back(language);
+        });
+        active->forEachTranslation(source, own, [&](const string& language, string_view text) {
+            items.push_back({&language, text});
+        });
+        if (items.size() == own.size()) {
+            strings.forEach(fn);
+            return;
+        }
+        stable_sort(items.begin(), items.end(), [](const auto& a, const auto& b) {
+            return *a.first < *b.first;
+        });
+        for (const auto& item : items) {
+            fn(*item.first, item.second);
+        }
+    }
+
+    Scope::Scope(const Table* table)
+        : mPrevious{active}
+    {
+        active = table;
+    }
+
+    Scope::~Scope() {
+        active = mPrevious;
+    }
+}
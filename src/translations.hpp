@@ -0,0 +1,114 @@
+#ifndef TRANSLATIONS_H
+#define TRANSLATIONS_H
+
+// Переводы строк проекта из файлов Strings/*.po, по файлу на язык:
+//     msgid ""
+//     msgstr "Language: en\n"
+//
+//     msgid "Номенклатура"
+//     msgstr "Products"
+// msgid - текст на основном языке конфигурации. Синонимы объектов хранят
+// только собственные строки, переводы подставляются при выгрузке из единой
+// таблицы по тексту на основном языке
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include "localised.hpp"
+
+namespace fs = std::filesystem;
+using namespace std;
+
+namespace translations {
+
+    // Таблица переводов. Все строки хранятся один раз в общей области
+    // памяти, переводы упорядочены по исходному тексту и языку
+    class Table {
+        public:
+        // sourceLanguage - код основного языка, languages - коды языков
+        // конфигурации: файлы на других языках пропускаются. В fallback
+        // ищутся строки, которых нет в этой таблице
+        Table(string sourceLanguage, vector<string> languages, const Table* fallback = nullptr);
+        Table(const Table&) = delete;
+        Table& operator=(const Table&) = delete;
+
+        // Загружает файл .po построчно. Язык файла берётся из заголовка
+        // Language. Возвращает false, если язык не входит в конфигурацию.
+        // При ошибке бросает runtime_error с файлом и строкой
+        bool load(const fs::path& path);
+
+        // Код основного языка
+        const string& getSourceLanguage() const;
+
+        // Вызывает fn(язык, перевод) для переводов source в порядке загрузки
+        // языков, пропуская языки из skip
+        void forEachTranslation(
+            string_view source,
+            const vector<string_view>& skip,
+            const function<void(const string&, string_view)>& fn
+        ) const;
+
+        // Количество переводов
+        size_t size() const;
+
+        // Отпечаток загруженного содержимого: меняется при любой правке
+        // файлов, для кэшей сборки
+        uint64_t getFingerprint() const;
+
+        private:
+        // Копирует строку в общую область, одинаковые строки хранятся один раз
+        string_view intern(string_view text);
+        void add(string_view source, size_t language, string_view text);
+
+        struct Entry {
+            string_view source;
+            uint32_t language;
+            string_view text;
+        };
+
+        string mSourceLanguage;
+        // Коды языков конфигурации
+        vector<string> mAllowed;
+        // Коды загруженных языков, Entry::language - индекс здесь
+        vector<string> mLanguages;
+        const Table* mFallback;
+        // Общая область строк: блоки не перемещаются, string_view на них
+        // остаются действительными
+        vector<unique_ptr<char[]>> mBlocks;
+        size_t mBlockUsed;
+        size_t mBlockSize;
+        unordered_set<string_view> mInterned;
+        vector<Entry> mEntries;
+        uint64_t mFingerprint;
+    };
+
+    // Таблица, по которой переводятся строки при выгрузке в текущем потоке.
+    // nullptr - переводов нет
+    const Table* getActive();
+
+    // Вызывает fn(язык, текст) для собственных строк strings и переводов их
+    // текста на основном языке из действующей таблицы, всё в порядке кодов
+    void forEachItem(
+        const lstring& strings,
+        const function<void(const string&, string_view)>& fn
+    );
+
+    // Делает таблицу действующей в текущем потоке до конца области видимости
+    class Scope {
+        public:
+        explicit Scope(const Table* table);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        private:
+        const Table* mPrevious;
+    };
+}
+
+#endif
@@ -15,7 +15,15 @@ namespace typing {
     // -- Ссылка -- //
     Ref::Ref(string classId, string id)
         : Type("cfg:" + classId + "." + id)
+        , mClassId(classId)
+        , mTargetName(id)
     {}
+    const string& Ref::getClassId() const {
+        return mClassId;
+    }
+    const string& Ref::getTargetName() const {
+        return mTargetName;
+    }
     
     // -- string -- //
     String::String(int length, bool variable)
@@ -24,6 +24,13 @@ namespace typing {
     class Ref : public Type {
     public:
         Ref(string classId, string id);
+        // Класс ссылки (CatalogRef, DocumentRef, ...)
+        const string& getClassId() const;
+        // Имя объекта, на который указывает ссылка
+        const string& getTargetName() const;
+    protected:
+        string mClassId;
+        string mTargetName;
     };
 
     // Тип строка
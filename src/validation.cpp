@@ -0,0 +1,42 @@
+#include "validation.hpp"
+
+namespace validation {
+
+    bool Index::add(const string& kind, const string& name) {
+        return mKeys.insert(kind + "." + name).second;
+    }
+
+    bool Index::contains(const string& kind, const string& name) const {
+        return mKeys.count(kind + "." + name) != 0;
+    }
+
+    string getTargetKind(const string& classId) {
+        if (classId == "CatalogRef") {
+            return "Catalog";
+        }
+        if (classId == "DocumentRef") {
+            return "Document";
+        }
+        return "";
+    }
+
+    void checkReferences(
+        const Index& index,
+        const vector<Reference>& references,
+        vector<Issue>& issues
+    ) {
+        for (const auto& ref : references) {
+            string kind = getTargetKind(ref.classId);
+            if (kind.empty()) {
+                issues.push_back({ref.owner, "неизвестный класс ссылки " + ref.classId});
+                continue;
+            }
+            if (!index.contains(kind, ref.target)) {
+                issues.push_back({
+                    ref.owner,
+                    "ссылка на несуществующий объект " + kind + "." + ref.target
+                });
+            }
+        }
+    }
+}
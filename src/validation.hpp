@@ -0,0 +1,56 @@
+#ifndef VALIDATION_H
+#define VALIDATION_H
+
+// Проверка ссылок между объектами конфигурации
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+namespace validation {
+
+    // Ссылка реквизита или колонки на объект конфигурации
+    struct Reference {
+        // Полное имя реквизита, в типе которого указана ссылка
+        string owner;
+        // Класс ссылки (CatalogRef, DocumentRef, ...)
+        string classId;
+        // Имя объекта, на который указывает ссылка
+        string target;
+    };
+
+    // Найденная ошибка
+    struct Issue {
+        // Где найдена (полное имя объекта или реквизита)
+        string where;
+        // Описание
+        string message;
+    };
+
+    // Индекс объектов конфигурации по виду и имени
+    class Index {
+        public:
+        // Добавляет объект. Возвращает false, если такой объект уже есть
+        bool add(const string& kind, const string& name);
+        // Есть ли объект с таким видом и именем
+        bool contains(const string& kind, const string& name) const;
+
+        private:
+        // Ключи вида "Catalog.Номенклатура"
+        unordered_set<string> mKeys;
+    };
+
+    // Возвращает вид объекта, на который указывает класс ссылки.
+    // Для неизвестных классов возвращает пустую строку
+    string getTargetKind(const string& classId);
+
+    // Проверяет ссылки по индексу, найденные ошибки дописывает в issues
+    void checkReferences(
+        const Index& index,
+        const vector<Reference>& references,
+        vector<Issue>& issues
+    );
+}
+
+#endif
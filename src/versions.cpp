@@ -0,0 +1,131 @@
+#include "versions.hpp"
+#include "ids.hpp"
+#include "targets.hpp"
+#include "xmltools.hpp"
+#include <fstream>
+#include <stdexcept>
+
+namespace versions {
+
+    // Оформление совпадает с тем, что выводил pugixml с форматированием по умолчанию
+    static string getHeader() {
+        return string(
+            "<?xml version=\"1.0\"?>\n"
+            "<ConfigDumpInfo"
+            " xmlns=\"http://v8.1c.ru/8.3/xcf/dumpinfo\""
+            " xmlns:xen=\"http://v8.1c.ru/8.3/xcf/enums\""
+            " xmlns:xs=\"http://www.w3.org/2001/XMLSchema\""
+            " xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\""
+            " format=\"") + targets::getFormat() + "\""
+            " version=\"" + targets::getVersion() + "\">\n";
+    }
+
+    void Shard::add(const string& name, const string& version) {
+        add(name, version, ids::getUUIDFor(name));
+    }
+
+    void Shard::add(const string& name, const string& version, const string& id) {
+        mData += "\t\t<Metadata name=\"";
+        xmltools::appendEscaped(mData, name, true);
+        mData += "\" id=\"";
+        mData += id;
+        mData += "\" configVersion=\"";
+        if (version.length() == 0) {
+            mData += ids::getConfigurationVersionString();
+        } else {
+            xmltools::appendEscaped(mData, version, true);
+        }
+        mData += "\" />\n";
+        mCount++;
+    }
+
+    void Shard::addSerialized(string_view entry) {
+        mData.append(entry.data(), entry.size());
+        mCount++;
+    }
+
+    size_t Shard::size() const {
+        return mCount;
+    }
+
+    const string& Shard::data() const {
+        return mData;
+    }
+
+    void writeConfigDumpInfo(fs::path path, const vector<const Shard*>& shards) {
+        ofstream out(path, ios::binary | ios::trunc);
+        if (!out) {
+            throw runtime_error("Не удалось открыть файл версий: " + path.string());
+        }
+
+        size_t total = 0;
+        for (const auto shard : shards) {
+            total += shard->size();
+        }
+
+        out << getHeader();
+        if (total == 0) {
+            out << "\t<ConfigVersions />\n";
+        } else {
+            out << "\t<ConfigVersions>\n";
+            for (const auto shard : shards) {
+                out.write(shard->data().data(), shard->data().size());
+            }
+            out << "\t</ConfigVersions>\n";
+        }
+        out << "</ConfigDumpInfo>\n";
+
+        if (!out) {
+            throw runtime_error("Не удалось записать файл версий: " + path.string());
+        }
+    }
+
+    // Значение атрибута name="..." в строке line, пустое - атрибута нет
+    static string_view getAttribute(string_view line, string_view name) {
+        string pattern = " " + string(name) + "=\"";
+        size_t start = line.find(pattern);
+        if (start == string_view::npos) {
+            return {};
+        }
+        start += pattern.size();
+        size_t end = line.find('"', start);
+        return end == string_view::npos ? string_view() : line.substr(start, end - start);
+    }
+
+    DumpInfo readConfigDumpInfo(const fs::path& path) {
+        string text = xmltools::readFile(path);
+        DumpInfo output;
+        bool header = false;
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            end = end == string::npos ? text.size() : end + 1;
+            string_view line(text.data() + start, end - start);
+            start = end;
+
+            if (!header) {
+                if (line.find("<ConfigDumpInfo") != string_view::npos) {
+                    output.version = string(getAttribute(line, "version"));
+                    header = true;
+                }
+                continue;
+            }
+            string_view name = getAttribute(line, "name");
+            if (line.find("<Metadata ") == string_view::npos || name.empty()) {
+                continue;
+            }
+            // Объект верхнего уровня - первые две части имени
+            size_t dot = name.find('.');
+            size_t second = dot == string_view::npos ? dot : name.find('.', dot + 1);
+            string_view object = name.substr(0, second);
+            if (output.objects.empty() || output.objects.back().object != object) {
+                output.objects.push_back({string(object), {}});
+            }
+            output.objects.back().entries.addSerialized(line);
+        }
+        if (!header) {
+            throw runtime_error("Не удалось прочитать файл версий: " + path.string());
+        }
+        return output;
+    }
+}
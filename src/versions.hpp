@@ -0,0 +1,63 @@
+#ifndef VERSIONS_H
+#define VERSIONS_H
+
+// Формирование файла версий ConfigDumpInfo.xml без построения DOM
+#include <string>
+#include <string_view>
+#include <vector>
+#include <filesystem>
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+namespace versions {
+
+    // Часть файла версий: записи <Metadata>, уже сериализованные в текст.
+    // Части заполняются независимо (в том числе в разных потоках) и затем
+    // склеиваются в каноническом порядке
+    class Shard {
+        public:
+        // Добавляет запись об объекте. Если version пуста, генерируется новая
+        void add(const string& name, const string& version);
+        // То же с явным идентификатором объекта, когда он не выводится
+        // из имени (например, у заимствованных объектов расширения)
+        void add(const string& name, const string& version, const string& id);
+        // Дописывает готовую запись: строку файла версий с переводом строки
+        void addSerialized(string_view entry);
+        // Количество записей
+        size_t size() const;
+        // Сериализованные записи
+        const string& data() const;
+
+        private:
+        string mData;
+        size_t mCount = 0;
+    };
+
+    // Записывает ConfigDumpInfo.xml потоком на диск без построения DOM:
+    // заголовок, части строго в порядке следования в shards, окончание
+    void writeConfigDumpInfo(fs::path path, const vector<const Shard*>& shards);
+
+    // Записи одного объекта верхнего уровня: сам объект, его реквизиты,
+    // формы и прочие подчинённые
+    struct ObjectEntries {
+        // Вид и имя объекта: Catalog.Товары
+        string object;
+        Shard entries;
+    };
+
+    // Содержимое файла версий
+    struct DumpInfo {
+        // Версия формата из заголовка
+        string version;
+        // Записи по объектам в порядке файла
+        vector<ObjectEntries> objects;
+    };
+
+    // Читает ConfigDumpInfo.xml, записанный writeConfigDumpInfo, построчно:
+    // записи не разбираются и остаются сериализованными
+    DumpInfo readConfigDumpInfo(const fs::path& path);
+}
+
+#endif
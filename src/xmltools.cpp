@@ -1,5 +1,12 @@
 #include "xmltools.hpp"
 #include "ids.hpp"
+#include "targets.hpp"
+#include "textkernel.hpp"
+#include "translations.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
 #include <spdlog/spdlog.h>
 
 namespace xmltools {
@@ -28,22 +35,237 @@ namespace xmltools {
         addSubNode(parent, "Comment", value);
     }
     
-    pugi::xml_node addConfigVersion(
-        pugi::xml_node parent,
-        string name,
-        string version)
-    {
-        pugi::xml_node entry = parent.append_child("Metadata");
-        entry.append_attribute("name").set_value(name);
-        entry.append_attribute("id").set_value(ids::getUUIDFor(name));
+    void appendEscaped(string& out, const string& value, bool attribute) {
+        if (!textkernel::appendEscaped(out, value.data(), value.size(), attribute)) {
+            throw runtime_error("Некорректный UTF-8: " + value);
+        }
+    }
+
+    // Имя узла или атрибута; безымянные pugixml выводит так же
+    static const char* nameOrDefault(const char* name) {
+        return *name ? name : ":anonymous";
+    }
 
-        if (version.length() == 0) {
-            entry.append_attribute("configVersion").set_value(ids::getConfigurationVersionString());
-        } else {
-            entry.append_attribute("configVersion").set_value(version);
+    // Дописывает значение узла или атрибута через ядро вывода текста
+    static void appendValue(string& out, const char* value, bool attribute, pugi::xml_node owner) {
+        if (!textkernel::appendEscaped(out, value, strlen(value), attribute)) {
+            throw runtime_error(string("Некорректный UTF-8 в узле <") + nameOrDefault(owner.name()) + ">");
         }
+    }
+
+    static void appendAttributes(string& out, pugi::xml_node node) {
+        for (pugi::xml_attribute a = node.first_attribute(); a; a = a.next_attribute()) {
+            out += ' ';
+            out += nameOrDefault(a.name());
+            out += "=\"";
+            appendValue(out, a.value(), true, node);
+            out += '"';
+        }
+    }
+
+    // Узлы без потомков: всё, кроме элементов и документа
+    static void appendSimpleNode(string& out, pugi::xml_node node) {
+        const char* value = node.value();
+        switch (node.type()) {
+            case pugi::node_pcdata:
+                appendValue(out, value, false, node.parent());
+                break;
+            case pugi::node_cdata:
+                // "]]>" внутри разрывает секцию на две
+                out += "<![CDATA[";
+                for (const char* s = value; *s;) {
+                    const char* end = strstr(s, "]]>");
+                    if (end == nullptr) {
+                        out += s;
+                        break;
+                    }
+                    out.append(s, end - s + 2);
+                    out += "]]><![CDATA[";
+                    s = end + 2;
+                }
+                out += "]]>";
+                break;
+            case pugi::node_comment:
+                // "--" и "-" в конце недопустимы в комментарии
+                out += "<!--";
+                for (const char* s = value; *s; s++) {
+                    out += *s;
+                    if (*s == '-' && (s[1] == '-' || s[1] == 0)) {
+                        out += ' ';
+                    }
+                }
+                out += "-->";
+                break;
+            case pugi::node_pi:
+                out += "<?";
+                out += nameOrDefault(node.name());
+                if (*value) {
+                    out += ' ';
+                    // "?>" внутри инструкции pugixml разрывает пробелом
+                    for (const char* s = value; *s; s++) {
+                        out += *s;
+                        if (*s == '?' && s[1] == '>') {
+                            out += ' ';
+                        }
+                    }
+                }
+                out += "?>";
+                break;
+            case pugi::node_declaration:
+                out += "<?";
+                out += nameOrDefault(node.name());
+                appendAttributes(out, node);
+                out += "?>";
+                break;
+            case pugi::node_doctype:
+                out += "<!DOCTYPE";
+                if (*value) {
+                    out += ' ';
+                    out += value;
+                }
+                out += '>';
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Повторяет node_output из pugixml с format_default: отступ табуляцией,
+    // текстовый узел пишется в строку с тегами элемента
+    static void appendNode(string& out, pugi::xml_node root) {
+        const unsigned indentNewline = 1;
+        const unsigned indentIndent = 2;
+        unsigned indentFlags = indentIndent;
+        size_t depth = 0;
+        pugi::xml_node node = root;
+
+        do {
+            if (node.type() == pugi::node_pcdata || node.type() == pugi::node_cdata) {
+                appendSimpleNode(out, node);
+                indentFlags = 0;
+            } else {
+                if (indentFlags & indentNewline) {
+                    out += '\n';
+                }
+                if (indentFlags & indentIndent) {
+                    out.append(depth, '\t');
+                }
+
+                if (node.type() == pugi::node_element) {
+                    indentFlags = indentNewline | indentIndent;
+                    out += '<';
+                    out += nameOrDefault(node.name());
+                    appendAttributes(out, node);
+                    if (node.first_child()) {
+                        out += '>';
+                        node = node.first_child();
+                        depth++;
+                        continue;
+                    }
+                    out += " />";
+                } else if (node.type() == pugi::node_document) {
+                    indentFlags = indentIndent;
+                    if (node.first_child()) {
+                        node = node.first_child();
+                        continue;
+                    }
+                } else {
+                    appendSimpleNode(out, node);
+                    indentFlags = indentNewline | indentIndent;
+                }
+            }
+
+            // Следующий узел; закрывающие теги пройденных элементов
+            while (node != root) {
+                if (node.next_sibling()) {
+                    node = node.next_sibling();
+                    break;
+                }
+                node = node.parent();
+                if (node.type() == pugi::node_element) {
+                    depth--;
+                    if (indentFlags & indentNewline) {
+                        out += '\n';
+                    }
+                    if (indentFlags & indentIndent) {
+                        out.append(depth, '\t');
+                    }
+                    out += "</";
+                    out += nameOrDefault(node.name());
+                    out += '>';
+                    indentFlags = indentNewline | indentIndent;
+                }
+            }
+        } while (node != root);
 
-        return entry;
+        if (indentFlags & indentNewline) {
+            out += '\n';
+        }
+    }
+
+    void serializeDocument(const pugi::xml_document& doc, string& out) {
+        // Объявление добавляется, если его нет до первого элемента
+        bool hasDeclaration = false;
+        for (pugi::xml_node child = doc.first_child(); child; child = child.next_sibling()) {
+            if (child.type() == pugi::node_declaration) {
+                hasDeclaration = true;
+                break;
+            }
+            if (child.type() == pugi::node_element) {
+                break;
+            }
+        }
+        if (!hasDeclaration) {
+            out += "<?xml version=\"1.0\"?>\n";
+        }
+        appendNode(out, doc);
+    }
+
+    void serializeNode(pugi::xml_node node, string& out) {
+        appendNode(out, node);
+    }
+
+    void saveDocument(const pugi::xml_document& doc, const fs::path& path) {
+        string out;
+        try {
+            serializeDocument(doc, out);
+        } catch (const runtime_error& e) {
+            throw runtime_error(path.string() + ": " + e.what());
+        }
+        writeFile(out, path);
+    }
+
+    void writeFile(const string& text, const fs::path& path) {
+        ofstream file(path, ios::binary | ios::trunc);
+        file.write(text.data(), text.size());
+        if (!file) {
+            throw runtime_error("Не удалось записать файл: " + path.string());
+        }
+    }
+
+    string readFile(const fs::path& path) {
+        // Каталог открывается как поток, но размер у него бессмысленный
+        error_code error;
+        if (!fs::is_regular_file(path, error)) {
+            throw runtime_error("Не удалось прочитать файл: " + path.string());
+        }
+        ifstream file(path, ios::binary);
+        if (!file) {
+            throw runtime_error("Не удалось прочитать файл: " + path.string());
+        }
+        string text;
+        file.seekg(0, ios::end);
+        streamoff size = file.tellg();
+        if (size < 0) {
+            throw runtime_error("Не удалось прочитать файл: " + path.string());
+        }
+        text.resize(static_cast<size_t>(size));
+        file.seekg(0, ios::beg);
+        file.read(&text[0], text.size());
+        if (!file) {
+            throw runtime_error("Не удалось прочитать файл: " + path.string());
+        }
+        return text;
     }
 
     void addChildObject(
@@ -73,31 +295,51 @@ namespace xmltools {
         node.append_attribute("xmlns:xr").set_value("http://v8.1c.ru/8.3/xcf/readable");
         node.append_attribute("xmlns:xs").set_value("http://www.w3.org/2001/XMLSchema");
         node.append_attribute("xmlns:xsi").set_value("http://www.w3.org/2001/XMLSchema-instance");
-        // TODO: version - ?
+        node.append_attribute("version").set_value(targets::getVersion().c_str());
+    }
+
+    // Коды языков выгрузки, пустой - все языки
+    static vector<string> languageFilter;
+
+    void setLanguageFilter(vector<string> codes) {
+        languageFilter = move(codes);
+    }
+
+    const vector<string>& getLanguageFilter() {
+        return languageFilter;
+    }
+
+    bool isLanguageIncluded(const string& code) {
+        return languageFilter.empty()
+            || find(languageFilter.begin(), languageFilter.end(), code) != languageFilter.end();
     }
 
-    unordered_map<string, string> parseLocalisedString(pugi::xml_node node) {
-        unordered_map<string, string> output;
+    lstring parseLocalisedString(pugi::xml_node node) {
+        lstring output;
         for (
             pugi::xml_node lang = node.child("localised-string").child("language");
             lang;
             lang = lang.next_sibling("language")
         ) {
-            output[lang.attribute("id").as_string()] = lang.text().get();
+            string code = lang.attribute("id").as_string();
+            if (!isLanguageIncluded(code)) {
+                continue;
+            }
+            output.set(code, lang.text().get());
         }
         return output;
     }
 
     void addLocalisedString(
         pugi::xml_node node,
-        unordered_map<string, string> langMap
+        const lstring& langMap
     )
     {
-        for (auto it : langMap) {
+        translations::forEachItem(langMap, [&](const string& lang, string_view text) {
             pugi::xml_node v8item = node.append_child("v8:item");
-            v8item.append_child("v8:lang").text().set(it.first);
-            v8item.append_child("v8:content").text().set(it.second);
-        }
+            v8item.append_child("v8:lang").text().set(lang);
+            v8item.append_child("v8:content").text().set(string(text));
+        });
     }
 
     void addGeneratedType(
@@ -113,6 +355,21 @@ namespace xmltools {
         generatedTypeNode.append_child("xr:ValueId").text().set(ids::getUUID());
     }
 
+    vector<string> splitTypeId(const string& typeId) {
+        // Разделение строки https://stackoverflow.com/a/46931770/15146417
+        string delimiter = "::";
+        size_t posStart = 0, posEnd, delimLen = delimiter.length();
+        string token;
+        vector<string> tokens;
+        while ((posEnd = typeId.find(delimiter, posStart)) != string::npos) {
+            token = typeId.substr(posStart, posEnd - posStart);
+            posStart = posEnd + delimLen;
+            tokens.push_back(token);
+        }
+        tokens.push_back(typeId.substr(posStart));
+        return tokens;
+    }
+
     shared_ptr<typing::Type> parseTypeNode(pugi::xml_node node) {
         string typeId = node.attribute("id").as_string();
 
@@ -142,23 +399,16 @@ namespace xmltools {
         }
 
         // Получить пространства имён
-        // Разделение строки https://stackoverflow.com/a/46931770/15146417
-        string delimiter = "::";
-        size_t posStart = 0, posEnd, delimLen = delimiter.length();
-        string token;
-        vector<string> tokens;
-        while ((posEnd = typeId.find(delimiter, posStart)) != string::npos) {
-            token = typeId.substr(posStart, posEnd - posStart);
-            posStart = posEnd + delimLen;
-            tokens.push_back(token);
-        }
-        tokens.push_back(typeId.substr(posStart));
+        vector<string> tokens = splitTypeId(typeId);
 
         if (tokens.size() == 3) {
             // ???::id
             if (tokens[1] == "CatalogRef") {
                 return make_shared<typing::Ref>("CatalogRef", tokens[2]);
             }
+            if (tokens[1] == "DocumentRef") {
+                return make_shared<typing::Ref>("DocumentRef", tokens[2]);
+            }
         }
 
         // Не понимаем что за тип
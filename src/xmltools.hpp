@@ -3,13 +3,17 @@
 
 // Файл для генерации разного рода идентификаторов
 #include <pugixml.hpp>
+#include <filesystem>
 #include <string>
-#include <unordered_map>
+#include <vector>
+#include "localised.hpp"
 #include "typing.hpp"
 #include <memory>
 
 using namespace std;
 
+namespace fs = std::filesystem;
+
 namespace xmltools {
 
     // Добавляет под-узел
@@ -26,12 +30,28 @@ namespace xmltools {
     // Добавляет <Comment> в узел XML
     void addCommentNode(pugi::xml_node parent, string value);
 
-    // Добавляет в узел версий запись об объекте
-    pugi::xml_node addConfigVersion(
-        pugi::xml_node parent,
-        string name,
-        string version
-    );
+    // Дописывает к out значение с экранированием, как это делает pugixml.
+    // attribute - экранировать как значение атрибута (иначе как текст узла).
+    // Некорректный UTF-8 - исключение runtime_error
+    void appendEscaped(string& out, const string& value, bool attribute);
+
+    // Сериализует документ в out байт в байт как save с format_default, но
+    // весь текст проходит через ядро textkernel: экранирование и проверка UTF-8
+    void serializeDocument(const pugi::xml_document& doc, string& out);
+
+    // Сериализует узел и его потомков так же, как serializeDocument, но без
+    // объявления XML. Узел выводится без отступа, в конце - перевод строки
+    void serializeNode(pugi::xml_node node, string& out);
+
+    // Записывает документ в файл одной операцией записи.
+    // Некорректный UTF-8 или ошибка записи - исключение runtime_error
+    void saveDocument(const pugi::xml_document& doc, const fs::path& path);
+
+    // Записывает готовый текст в файл одной операцией записи
+    void writeFile(const string& text, const fs::path& path);
+
+    // Читает файл целиком
+    string readFile(const fs::path& path);
 
     // Добавляет в узел детских объектов описание объекта
     // childrenNode - узел <ChildObjects>
@@ -45,13 +65,24 @@ namespace xmltools {
     // Добавляет пространства имёт в объект
     void addNamespaces(pugi::xml_node node);
 
-    // Парсит <localised-string> из проекта super в map
-    unordered_map<string, string> parseLocalisedString(pugi::xml_node node);
+    // Оставляет в локализованных строках только языки с кодами codes.
+    // Пустой список - все языки. Устанавливается до сбора объектов
+    void setLanguageFilter(vector<string> codes);
+
+    // Коды языков выгрузки, пустой список - все языки
+    const vector<string>& getLanguageFilter();
+
+    // Входит ли язык с кодом code в выгрузку
+    bool isLanguageIncluded(const string& code);
+
+    // Парсит <localised-string> из проекта super. Строки на языках, не
+    // вошедших в выгрузку, пропускаются
+    lstring parseLocalisedString(pugi::xml_node node);
 
     // Добавляет в файл выгрузки объекта локализованную строку
     void addLocalisedString(
         pugi::xml_node node,
-        unordered_map<string, string> langMap
+        const lstring& langMap
     );
 
     // Добавляет узел GeneratedType для родителя "InternalInfo"
@@ -61,6 +92,9 @@ namespace xmltools {
         string category
     );
 
+    // Разбивает идентификатор типа SUPER на части по "::"
+    vector<string> splitTypeId(const string& typeId);
+
     // Парсит тип из узла SUPER
     shared_ptr<typing::Type> parseTypeNode(pugi::xml_node node);
 }
@@ -0,0 +1,20 @@
+// Проверки modules::validate: meson test -C bin
+#include "modules.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main() {
+    // Модуль с BOM, как его пишут конфигуратор и EDT: проверка не должна
+    // принимать BOM за часть первого слова
+    const string module = "\xEF\xBB\xBFПроцедура Тест()\n    Сообщить(\"Тест\");\nКонецПроцедуры\n";
+    try {
+        modules::validate(module, "bom.bsl");
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+// Проверки textkernel: все реализации, доступные на процессоре, должны
+// совпадать со scalar по экранированному тексту и по проверке UTF-8
+#include "textkernel.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static vector<textkernel::Kernel> kernels;
+static size_t failures = 0;
+
+// Сравнивает реализации на input. expected: 1 - корректный UTF-8,
+// 0 - некорректный, -1 - не проверять по эталону
+static void check(const string& input, bool attribute, int expected = -1) {
+    const auto& reference = kernels.front();
+    string referenceText;
+    bool referenceValid = reference.appendEscaped(referenceText, input.data(), input.size(), attribute);
+    if (expected != -1 && referenceValid != (expected == 1)) {
+        cerr << "scalar: неверная проверка UTF-8, длина " << input.size() << endl;
+        failures++;
+    }
+    for (size_t i = 1; i < kernels.size(); i++) {
+        const auto& kernel = kernels[i];
+        string text;
+        bool valid = kernel.appendEscaped(text, input.data(), input.size(), attribute);
+        bool onlyValid = kernel.isValidUtf8(input.data(), input.size());
+        if (valid != referenceValid || onlyValid != referenceValid || text != referenceText) {
+            cerr << kernel.name << ": расхождение со scalar, длина " << input.size()
+                 << (attribute ? ", атрибут" : ", текст") << endl;
+            failures++;
+        }
+    }
+}
+
+static void checkBoth(const string& input, int expected = -1) {
+    check(input, false, expected);
+    check(input, true, expected);
+}
+
+int main() {
+    kernels = textkernel::getKernels();
+    if (kernels.size() < 2) {
+        cout << "Нет реализаций кроме scalar" << endl;
+        return 77;
+    }
+
+    // Многобайтовые последовательности на границе 32-байтовых блоков
+    const vector<string> sequences = {"Ж", "€", "\xF0\x9F\x98\x80"};
+    for (const auto& sequence : sequences) {
+        for (size_t prefix = 0; prefix <= 70; prefix++) {
+            for (size_t suffix = 0; suffix <= 40; suffix++) {
+                checkBoth(string(prefix, 'a') + sequence + string(suffix, 'b'), 1);
+            }
+        }
+    }
+
+    // Обрыв последовательности в конце хвоста
+    for (const auto& sequence : sequences) {
+        for (size_t length = 1; length < sequence.size(); length++) {
+            for (size_t prefix = 0; prefix <= 70; prefix++) {
+                checkBoth(string(prefix, 'a') + sequence.substr(0, length), 0);
+            }
+        }
+    }
+
+    // Слишком длинные записи, суррогаты, точки выше U+10FFFF и граничные
+    // корректные значения
+    const vector<pair<string, int>> points = {
+        {"\xC0\x80", 0}, {"\xC1\xBF", 0},
+        {"\xE0\x80\x80", 0}, {"\xE0\x9F\xBF", 0},
+        {"\xF0\x80\x80\x80", 0}, {"\xF0\x8F\xBF\xBF", 0},
+        {"\xED\xA0\x80", 0}, {"\xED\xBF\xBF", 0},
+        {"\xF4\x90\x80\x80", 0}, {"\xF5\x80\x80\x80", 0}, {"\xFF", 0},
+        {"\x80", 0}, {"\xC2\x80\x80", 0}, {"\xE2\x82", 0},
+        {"\xC2\x80", 1}, {"\xDF\xBF", 1},
+        {"\xE0\xA0\x80", 1}, {"\xED\x9F\xBF", 1}, {"\xEE\x80\x80", 1}, {"\xEF\xBF\xBF", 1},
+        {"\xF0\x90\x80\x80", 1}, {"\xF4\x8F\xBF\xBF", 1}
+    };
+    for (const auto& point : points) {
+        for (size_t prefix = 0; prefix <= 70; prefix++) {
+            checkBoth(string(prefix, 'a') + point.first + string(prefix % 7, 'b'), point.second);
+        }
+    }
+
+    // Управляющие символы и & < > " на каждой позиции двух блоков
+    string specials = "&<>\"";
+    for (int c = 0; c < 0x20; c++) {
+        specials += static_cast<char>(c);
+    }
+    for (char special : specials) {
+        for (size_t position = 0; position < 64; position++) {
+            for (size_t size : {position + 1, size_t(64), size_t(80)}) {
+                string input(size, 'x');
+                input[position] = special;
+                checkBoth(input, 1);
+            }
+        }
+    }
+
+    if (failures != 0) {
+        cerr << "Расхождений: " << failures << endl;
+        return 1;
+    }
+    return 0;
+}